@@ -21,6 +21,14 @@ size_t read_iteration_count=10;
 bool verbose = false;
 bool dont_remove = false;
 bool enable_dyn_cache = false;
+bool enable_wal = false;
+size_t writer_lanes = 1;
+bool time_ordered = false;
+bool spare_pages = false;
+bool postings = false;
+mdb::MapOptions map_options;
+std::string ingest_mode = "locked";
+std::string pool_policy = "block";
 size_t cache_size = mdb::defaultcacheSize;
 size_t cache_pool_size = mdb::defaultcachePoolSize;
 mdb::Storage::Storage_ptr ds = nullptr;
@@ -38,8 +46,26 @@ void makeStorage() {
     ds = mdb::Storage::Create(storage_path, storage_size);
 
 	ds->enableCacheDynamicSize(enable_dyn_cache);
+	ds->enableWal(enable_wal);
+	ds->setWriterLanes(writer_lanes);
+	ds->setTimeOrdered(time_ordered);
+	ds->setSparePages(spare_pages);
+	ds->enablePostings(postings);
+	ds->setMapOptions(map_options);
 	ds->setPoolSize(cache_pool_size);
 	ds->setCacheSize(cache_size);
+	if (ingest_mode == "ring") {
+		ds->setIngestMode(mdb::IngestMode::LockFreeRing);
+	}
+	if (ingest_mode == "shards") {
+		ds->setIngestMode(mdb::IngestMode::ThreadShards);
+	}
+	if (pool_policy == "drop") {
+		ds->setPoolPolicy(mdb::PoolPolicy::Drop);
+	}
+	if (pool_policy == "grow") {
+		ds->setPoolPolicy(mdb::PoolPolicy::Grow);
+	}
 }
 
 void writer(int writeCount) {
@@ -106,6 +132,17 @@ int main(int argc, char *argv[]) {
 	desc.add_options()("help", "produce help message")(
         "mc", po::value<size_t>(&meas2write)->default_value(meas2write), "measurment count")
 		("dyncache", po::value<bool>(&enable_dyn_cache)->default_value(enable_dyn_cache), "enable dynamic cache")
+		("map-populate", po::value<bool>(&map_options.populate)->default_value(map_options.populate), "prefault written pages")
+		("map-huge", po::value<bool>(&map_options.hugePages)->default_value(map_options.hugePages), "huge pages for written pages")
+		("map-sequential", po::value<bool>(&map_options.sequential)->default_value(map_options.sequential), "sequential access hint for readed pages")
+		("map-dontneed", po::value<bool>(&map_options.dontNeed)->default_value(map_options.dontNeed), "drop full pages from page cache on close")
+		("postings", po::value<bool>(&postings)->default_value(postings), "build id postings of sealed pages")
+		("spare-pages", po::value<bool>(&spare_pages)->default_value(spare_pages), "pre-create next page in background")
+		("time-ordered", po::value<bool>(&time_ordered)->default_value(time_ordered), "sort values by time before write to page")
+		("writer-lanes", po::value<size_t>(&writer_lanes)->default_value(writer_lanes), "count of parallel page writers")
+		("wal", po::value<bool>(&enable_wal)->default_value(enable_wal), "log cached values to WAL")
+		("ingest-mode", po::value<std::string>(&ingest_mode)->default_value(ingest_mode), "locked|ring|shards")
+		("pool-policy", po::value<std::string>(&pool_policy)->default_value(pool_policy), "block|drop|grow")
 		("cache-size", po::value<size_t>(&cache_size)->default_value(cache_size), "cache size")
 		("cache-pool-size", po::value<size_t>(&cache_pool_size)->default_value(cache_pool_size), "cache pool size")
         ("thread-count", po::value<size_t>(&thread_count)->default_value(thread_count), "write thread count")
@@ -155,6 +192,9 @@ int main(int argc, char *argv[]) {
 
 	stop_info = true;
 	info_thread.join();
+	if (ds->droppedCount() != 0) {
+		logger("dropped: " << ds->droppedCount());
+	}
 
 	/// readers
 	stop_info = false;
@@ -12,8 +12,9 @@ namespace utils {
 // look usage example in utils_test.cpp
 template <class T> class AsyncWorker {
 public:
+    AsyncWorker() : m_stop_flag(true), m_thread_work(false) {}
     virtual ~AsyncWorker(){
-        if(m_thread_work){
+        if(m_thread.joinable()){
             this->kill();
         }
     }
@@ -32,12 +33,14 @@ public:
   }
 
   void kill() {
-    m_stop_flag = true;
-    while (m_thread_work) {
-      m_have_data.notify_one();
+    {
+      std::lock_guard<std::mutex> lock(m_add_lock);
+      m_stop_flag = true;
+    }
+    m_have_data.notify_all();
+    if (m_thread.joinable()) {
+      m_thread.join();
     }
-
-    m_thread.join();
   }
 
   /// whait, while all works done and stop thread.
@@ -52,7 +55,11 @@ public:
     }
   }
 
-  bool isBusy() const { return !m_data.empty(); }
+  /// have not processed data (data removed from queue after call)
+  bool isBusy() const {
+    std::lock_guard<std::mutex> lock(m_add_lock);
+    return !m_data.empty();
+  }
 
   void pause_work() { m_thread_lock.lock(); }
 
@@ -62,25 +69,24 @@ public:
 
 protected:
   void _thread_func() {
-    std::unique_lock<std::mutex> lock(m_thread_lock);
     m_thread_work = true;
     while (true) {
-      while (m_data.empty()) {
+      std::unique_lock<std::mutex> lock(m_add_lock);
+      while (m_data.empty() && !m_stop_flag) {
         m_have_data.wait(lock);
-
-        if (m_stop_flag) {
-          break;
-        }
       }
-
       if (m_stop_flag) {
         break;
       }
-      m_add_lock.lock();
       T d = m_data.front();
+      lock.unlock();
+      {
+        // pause_work holds this lock
+        std::lock_guard<std::mutex> thread_lock(m_thread_lock);
+        this->call(d);
+      }
+      lock.lock();
       m_data.pop();
-      m_add_lock.unlock();
-      this->call(d);
     }
     m_thread_work = false;
   }
@@ -3,23 +3,57 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include "meas.h"
 #include "common.h"
+#include "utils.h"
+#include "wal.h"
 
 namespace mdb {
 class Storage;
+class CachePool;
+
+/**
+* State of Storage::appendAsync. Each cache with values of append holds
+* pending part, append is done when last part released.
+*/
+class AppendTicket : public utils::NonCopy {
+public:
+    typedef std::function<void(append_result)> Callback;
+    AppendTicket(Callback callback, bool sync);
+    void addPending(size_t count);
+    /// return true, if it was last pending part.
+    bool release();
+    void complete();
+
+    append_result result;
+    /// sync pages before callback.
+    const bool sync;
+private:
+    std::atomic<size_t> m_pending;
+    Callback m_callback;
+};
+typedef std::shared_ptr<AppendTicket> AppendTicket_ptr;
+typedef std::vector<AppendTicket_ptr> AppendTickets;
 
 /**
   * Cache of values. after  fulled, cache write to page.
     */
-class Cache {
+class Cache : public std::enable_shared_from_this<Cache> {
 public:
     typedef std::shared_ptr<Cache> PCache;
     Cache(size_t size);
     ~Cache();
     bool isFull() const;
     append_result append(const Meas &value, const Time past_time);
+    /// cur_values - write values to cur values of storage.
     append_result append(const Meas::PMeas begin, const size_t size,
+                         const Time past_time, bool cur_values = true);
+    /// write rows [from, columns.count) directly to cache.
+    append_result append(const MeasColumns &columns, const size_t from,
                          const Time past_time);
     mdb::Meas::MeasList readInterval(Time from, Time to) const;
     Meas::PMeas asArray() const;
@@ -30,9 +64,22 @@ public:
     /// this cache is ander sync
     bool is_sync() const;
     void sync_begin();
+    /// cache written to page, it returned to pool.
     void sync_complete();
+    /// count of writer lanes, which must write this cache.
+    void setPendingLanes(size_t lanes);
+    /// lane wrote its values. return true for last lane.
+    bool laneComplete();
 
     void setStorage(Storage*ds);
+    /// WAL segments with values of this cache.
+    WAL::Segments &walSegments() { return m_wal_segments; }
+    /// segments of cache, while it written to pages.
+    WALHold_ptr walHold() const { return m_wal_hold; }
+    void setWalHold(const WALHold_ptr &hold) { m_wal_hold = hold; }
+    /// async appends with values in cache. ticket added once and hold one pending part.
+    void addTicket(const AppendTicket_ptr &ticket);
+    const AppendTickets &tickets() const { return m_tickets; }
 private:
     // typedef std::map<storage::Time, std::list<size_t>> time2meas;
 
@@ -41,54 +88,136 @@ private:
     // time2meas m_data;
     size_t m_size;
     size_t m_index;
-    bool m_sync;
+    std::atomic<bool> m_sync;
+    std::atomic<size_t> m_pending_lanes;
     Storage*m_ds;
+    /// pool may be destroyed before cache, released by writer.
+    std::weak_ptr<CachePool> m_pool;
+    WAL::Segments m_wal_segments;
+    WALHold_ptr m_wal_hold;
+    AppendTickets m_tickets;
+    friend class CachePool;
+};
+
+/// what CachePool do, when all caches are busy.
+enum class PoolPolicy {
+  /// wait, while AsyncWriter release some cache.
+  Block,
+  /// return nothing, writer drop values and increment dropped counter.
+  Drop,
+  /// allocate new cache, while memory budget allow it. after that - block.
+  Grow
 };
 
 /**
-* Pool of caches.
+* Pool of caches, must be owned by shared_ptr.
+* Caches allocated on demand up to pool size. Free caches stored in free list,
+* cache returned to it on Cache::sync_complete.
 */
-class CachePool : std::vector<Cache::PCache> {
-    CachePool() {}
-
+class CachePool : public utils::NonCopy, public std::enable_shared_from_this<CachePool> {
 public:
     CachePool(const size_t pool_size, const size_t cache_size);
     /// have free cache for write
-    bool haveCache();
-    /// get cache to write
+    bool haveCache() const;
+    /// get cache to write. if pool is empty, act by policy.
     Cache::PCache getCache();
+    /// get cache without waiting. return nullptr if no free cache.
+    Cache::PCache tryGetCache();
+    /// wait, while pool has no free cache and can`t allocate one. policy ignored.
+    void waitCache();
+    /// return cache to free list.
+    void release(const Cache::PCache &c);
+
     void setCacheSize(const size_t sz);
     size_t getCacheSize()const;
     void setPoolSize(const size_t sz);
     size_t getPoolSize()const;
 
-    /// enable dynamic cache size
+    /// memory_budget - max size of all caches in bytes for PoolPolicy::Grow. 0 - unlimited.
+    void setPolicy(PoolPolicy policy, size_t memory_budget = 0);
+    PoolPolicy policy() const;
+    /// count of values dropped by PoolPolicy::Drop
+    uint64_t droppedCount() const;
+    void addDropped(size_t count);
+
+    /// enable dynamic cache size (same as PoolPolicy::Grow without budget)
     void enableDynamicSize(bool flg);
     /// is dynamic size enabled
     bool dynamicSize() const;
 
 protected:
-    void init_pool();
+    Cache::PCache newCache();
+    /// can allocate cache: pool not filled or policy allows grow.
+    bool canAllocate() const;
+    bool canGrow() const;
 
 private:
     size_t m_pool_size, m_cache_size;
-    size_t m_default_pool_size;  // pool size on it init.
-    //size_t m_default_cache_size; // pool size on it init.
-    int m_recalc_period;
-    bool m_dynamic_size;
+    /// count of allocated caches (free and busy).
+    size_t m_total;
+    PoolPolicy m_policy;
+    size_t m_memory_budget;
+    std::atomic<uint64_t> m_dropped;
+    std::vector<Cache::PCache> m_free;
+    mutable std::mutex m_lock;
+    std::condition_variable m_have_free;
 };
+typedef std::shared_ptr<CachePool> CachePool_ptr;
+
+const size_t defaultCurValuesCapacity = 1 << 16;
 
 /**
-* Cache of cur values
+* Cache of cur values.
+* Open addressing table, value of slot guarded by seqlock: writers of one id
+* serialized by slot sequence, readers never block writers and retry on torn read.
+* When table is filled on 3/4, it doubled: values moved to new table under grow
+* lock, writers of moving table repeat write in new table. Old tables are kept
+* until destruction, readers may still use them.
 */
-class CurValuesCache
+class CurValuesCache : public utils::NonCopy
 {
 public:
-    CurValuesCache();
+    explicit CurValuesCache(size_t capacity = defaultCurValuesCapacity);
+    /// value with newest time wins.
     void writeValue(const mdb::Meas&v);
+    /// Meas::empty() for not found ids.
     mdb::Meas::MeasList readValue(const mdb::IdArray&ids)const;
+    size_t size()const;
+    /// count of slots of current table.
+    size_t capacity()const;
+private:
+    static const size_t meas_words = sizeof(Meas) / sizeof(uint64_t);
+    struct Slot {
+        /// odd while value is writing
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> value[meas_words];
+    };
+    struct Table {
+        explicit Table(size_t capacity);
+        size_t home(Id id)const;
+        /// slot of id. if not exists and insert, new slot claimed. nullptr if not found or table full.
+        Slot *findSlot(Id id, bool insert);
+
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        size_t max_size;
+        std::atomic<size_t> size;
+        /// slot of max id, which is key of empty slots.
+        Slot max_id;
+        /// values of table are moving to bigger table.
+        std::atomic<bool> moved;
+    };
+    static void initSlot(Slot&slot);
+    static bool readSlot(const Slot&slot, Meas*output);
+    static void writeSlot(Slot&slot, const Meas&v);
+    /// double table, if it is current. return current table.
+    Table *grow(Table *table);
 private:
-    std::map<mdb::Id, mdb::Meas> m_values;
+    std::atomic<Table*> m_table;
+    /// all tables, current is last.
+    std::vector<std::unique_ptr<Table>> m_tables;
+    std::mutex m_grow_lock;
 };
 
 }
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "meas.h"
+
+namespace mdb
+{
+	class IdFilter;
+	typedef std::shared_ptr<const IdFilter> IdFilter_ptr;
+
+	/**
+	* Set of ids, compiled once per query and shared by its page readers. Dense range of ids stored as bitmap,
+	* sparse as hash set, so check of value is O(1) for any count of ids.
+	* Empty filter contains all ids.
+	*/
+	class IdFilter
+	{
+	public:
+		/// max bits of bitmap per id of filter.
+		static const uint64_t bitmap_density = 64;
+		/// range of ids, always stored as bitmap (8Kb).
+		static const uint64_t bitmap_min_range = 1 << 16;
+
+		IdFilter();
+		explicit IdFilter(const IdArray &ids);
+		/// shared filter of all ids.
+		static IdFilter_ptr all();
+		/// shared filter of ids, all() for empty ids.
+		static IdFilter_ptr make(const IdArray &ids);
+
+		bool empty() const { return m_kind == Kind::All; }
+		bool isBitmap() const { return m_kind == Kind::Bitmap; }
+
+		bool contains(Id id) const {
+			switch (m_kind) {
+			case Kind::Bitmap: {
+				// ids less than m_min wrap to big offset.
+				uint64_t offset = id - m_min;
+				return (offset < m_range) && ((m_bits[offset >> 6] >> (offset & 63)) & 1);
+			}
+			case Kind::Hash:
+				return m_set.find(id) != m_set.end();
+			default:
+				return true;
+			}
+		}
+	private:
+		enum class Kind { All, Bitmap, Hash };
+		Kind m_kind;
+		Id m_min;
+		uint64_t m_range;
+		std::vector<uint64_t> m_bits;
+		std::unordered_set<Id> m_set;
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "meas.h"
+#include "page.h"
+#include "writewindow.h"
+#include "utils.h"
+
+#include <string>
+#include <vector>
+
+namespace mdb {
+
+/**
+* Bulk import of history, past caches and AsyncWriter.
+* Values collected to chunk of one page, chunk sorted by time and written
+* to new page. Each page get write window of previous, so time point reads
+* work as for pages of Storage. Storage in path must be closed.
+*/
+class Importer : public utils::NonCopy {
+public:
+  /// page_size in bytes, as in Storage::Create.
+  Importer(const std::string &path, uint64_t page_size);
+  ~Importer();
+  void append(const Meas::PMeas begin, const size_t count);
+  /// write not full chunk and close last page. pages synced to disk on write.
+  void close();
+  /// count of created pages.
+  size_t pagesCount() const { return m_pages; }
+  /// build postings of created pages.
+  void enablePostings(bool flg) { m_postings = flg; }
+
+  /// parse lines "id,time,value[,source[,flag]]". not numeric lines skipped.
+  /// text must end by line end or by null terminator.
+  /// return count of skipped lines.
+  static size_t parseCsv(const char *begin, const char *end, Meas::MeasArray *output);
+  /// split text to parts by lines and parse them in threads.
+  static size_t parseCsv(const char *begin, const char *end, size_t threads,
+                         Meas::MeasArray *output);
+
+private:
+  void writeChunk();
+
+private:
+  std::string m_path;
+  uint64_t m_page_size;
+  size_t m_chunk_size;
+  Meas::MeasArray m_chunk;
+  WriteWindow m_ww;
+  size_t m_pages;
+  bool m_postings;
+};
+}
@@ -1,12 +1,25 @@
 #pragma once
 
 #include "meas.h"
+#include "utils.h"
+#include "postings.h"
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
 namespace mdb
 {
-	const uint16_t index_file_format=1;
+	const uint16_t index_file_format=2;
+	/// max count of measurements described by one index record.
+	const uint64_t index_block_size=1024;
     /**
     * Implement index for page.
+    * Sparse block index: one record per index_block_size measurements,
+    * with min/max of time and id. Blocks kept in memory, changed blocks
+    * rewrited in file by flush.
     */
 	class Index
 	{
@@ -24,15 +37,75 @@ namespace mdb
 		{
 			uint16_t format;
 		};
+		/// immutable blocks of sealed page.
+		struct Blocks
+		{
+			std::vector<IndexRecord> records;
+			/// max of maxTime of records [0,i] and min of minTime of records [i,n).
+			/// both are sorted, so blocks of interval found by binary search.
+			std::vector<Time> maxTimePrefix;
+			std::vector<Time> minTimeSuffix;
+		};
+		typedef std::shared_ptr<const Blocks> Blocks_ptr;
 	public:
 		Index();
 		~Index();
 		std::string fileName()const;
 		void setFileName(const std::string& fname);
-		void writeIndexRec(const IndexRecord &rec);
-		std::list<Index::IndexRecord> findInIndex(const IdArray &ids, Time from, Time to) const;
+		/// remove all records from file.
+		void reset();
+		/// add measurement writed in page position pos.
+		void append(const Meas &value, uint64_t pos);
+		void append(const Meas::PMeas begin, const size_t count, uint64_t pos);
+		/// write changed blocks to file.
+		void flush();
+		/// flush and force index file to disk.
+		void sync();
+		/// count of records (blocks)
+		size_t size();
+		std::list<Index::IndexRecord> findInIndex(const IdArray &ids, Time from, Time to);
+		/// index of page not changed: use blocks from IndexCache, if index file
+		/// already contains blocks of all values_count values.
+		void useShared(uint64_t values_count);
+		static Blocks_ptr ReadBlocks(const std::string &fname);
+		/// read header of openned index file. close file and throw, if format unknown.
+		static void CheckFormat(FILE *pFile, const std::string &fname);
+	private:
+		void loadBlocks();
+		/// block, which can store measurement in pos.
+		IndexRecord* blockFor(uint64_t pos);
 	private:
 		std::string m_fname;
+		FILE *m_file;
+		std::vector<IndexRecord> m_blocks;
+		bool m_loaded;
+		/// first block changed after last flush.
+		size_t m_dirty_from;
+		Blocks_ptr m_shared;
 	};
 
+	/**
+	* Blocks and postings of sealed pages, shared by all readers of process.
+	* Loaded on first read of page, erased when page removed or recreated.
+	*/
+	class IndexCache : public utils::NonCopy
+	{
+	public:
+		static IndexCache *get();
+		/// nullptr, if blocks in file not cover values_count values (writer not flushed index yet).
+		Index::Blocks_ptr blocks(const std::string &fname, uint64_t values_count);
+		/// nullptr, if page have no postings.
+		Postings::Postings_ptr postings(const std::string &fname);
+		void erase(const std::string &fname);
+		/// erase index and postings of page.
+		void erasePage(const std::string &page_name);
+		void clear();
+		size_t size() const;
+	private:
+		IndexCache() = default;
+	private:
+		std::map<std::string, Index::Blocks_ptr> m_blocks;
+		std::map<std::string, Postings::Postings_ptr> m_postings;
+		mutable std::mutex m_lock;
+	};
 }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "meas.h"
+#include "id_filter.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mdb {
+/**
+* Batch kernels of hot loops. SIMD version selected in runtime,
+* scalar version used on other cpu and compilers.
+*/
+namespace kernels {
+
+/// copy values, which pass past time check (cur_time - time <= past_time), to dst.
+/// dst must have space for count values. return count of copied values.
+size_t filterPastTime(const Meas *src, size_t count, Time cur_time, Time past_time, Meas *dst);
+size_t filterPastTimeScalar(const Meas *src, size_t count, Time cur_time, Time past_time, Meas *dst);
+
+/// predicates of scan. zero source or flag, nullptr or empty ids - any value.
+struct ScanFilter {
+  ScanFilter() : checkTime(true), from(0), to(0), source(0), flag(0), ids(nullptr) {}
+  /// check time in [from, to].
+  bool checkTime;
+  Time from;
+  Time to;
+  Flag source;
+  Flag flag;
+  const IdFilter *ids;
+};
+
+/// write to sel positions of values in src, which pass filter, in order.
+/// sel must have space for count positions. return count of selected values.
+size_t scan(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel);
+size_t scanScalar(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel);
+/// SIMD versions of scan, call only if haveAVX2()/haveAVX512().
+/// if compiler has no x86 intrinsics, same as scanScalar.
+size_t scanAVX2(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel);
+size_t scanAVX512(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel);
+
+/// is AVX2 version of kernels used.
+bool haveAVX2();
+/// is AVX-512 version of scan used.
+bool haveAVX512();
+}
+}
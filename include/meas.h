@@ -30,5 +30,48 @@ struct Meas {
   Value value;
 };
 
+/// order of values in time sorted pages.
+struct MeasCmpByTime {
+  bool operator()(const Meas &a, const Meas &b) const {
+    return (a.time < b.time) || ((a.time == b.time) && (a.id < b.id));
+  }
+};
+
+/// column of batch: array with value of each row or one value of all rows.
+template <class T> struct Column {
+  Column() : data(nullptr), scalar() {}
+  Column(const T *values) : data(values), scalar() {}
+  Column(const T value) : data(nullptr), scalar(value) {}
+  T operator[](size_t row) const { return data != nullptr ? data[row] : scalar; }
+
+  const T *data;
+  T scalar;
+};
+
+/// batch of values stored by columns, without array of Meas.
+struct MeasColumns {
+  MeasColumns() : count(0) {}
+  Meas at(size_t row) const {
+    Meas result;
+    result.id = ids[row];
+    result.time = times[row];
+    result.source = sources[row];
+    result.flag = flags[row];
+    result.value = values[row];
+    return result;
+  }
+
+  size_t count;
+  Column<Id> ids;
+  Column<Time> times;
+  Column<Flag> sources;
+  Column<Flag> flags;
+  Column<Value> values;
+};
+
 bool checkPastTime(const Time t, const Time past_time); // |current time - t| < past_time
+/// same, with current time readed by caller once per batch.
+inline bool checkPastTime(const Time t, const Time past_time, const Time cur_time) {
+  return (past_time == 0) || ((cur_time - t) <= past_time);
+}
 }
@@ -7,11 +7,15 @@
 #include <string>
 #include <map>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "meas.h"
 #include "index.h"
 #include "writewindow.h"
+#include "id_filter.h"
 
 namespace mdb {
 
@@ -19,13 +23,29 @@ class PageReader;
 typedef std::shared_ptr<PageReader> PageReader_ptr;
 
 
+/// options of page mapping. not supported options are ignored.
+struct MapOptions {
+  MapOptions();
+  /// prefault pages of mapping (MAP_POPULATE) on create and open for write.
+  bool populate;
+  /// transparent huge pages (MADV_HUGEPAGE) for written page. for hugetlbfs
+  /// place storage on hugetlbfs mount.
+  bool hugePages;
+  /// MADV_SEQUENTIAL for pages openned to read.
+  bool sequential;
+  /// drop full page from page cache on close (MADV_DONTNEED, POSIX_FADV_DONTNEED).
+  bool dontNeed;
+};
+
 /**
 * Page class.
 * Header + [meas_0...meas_i]
 */
 class Page : public utils::NonCopy, public std::enable_shared_from_this<Page> {
 public:
-    static const uint8_t page_version = 1;
+    static const uint8_t page_version = 3;
+    /// min count of values in write window file.
+    static const uint64_t ww_min_capacity = 1024;
   struct Header {
     /// format version
     uint8_t version;
@@ -47,15 +67,27 @@ public:
     /// size in bytes
     uint64_t size;
     uint64_t WriteWindowSize;
+    /// writer lane of page and count of lanes, when page was created.
+    uint32_t lane;
+    uint32_t lanes;
+    /// values writed in order of time.
+    bool timeSorted;
   };
 
   typedef std::shared_ptr<Page> Page_ptr;
 
 public:
-  static Page_ptr Open(std::string filename, bool readOnly=false);
-  static Page_ptr Create(std::string filename, uint64_t fsize);
+  static Page_ptr Open(std::string filename, bool readOnly=false, const MapOptions &options = MapOptions());
+  static Page_ptr Create(std::string filename, uint64_t fsize, uint32_t lane = 0, uint32_t lanes = 1,
+                         const MapOptions &options = MapOptions());
+  /// build postings (id -> positions) of page, when writer seals it.
+  void setBuildPostings(bool flg) { m_build_postings = flg; }
   /// read only header from page file.
   static Page::Header ReadHeader(std::string filename);
+  /// throw, if page written in other format version.
+  static void CheckVersion(const Header &hdr, const std::string &filename);
+  /// writer lane of measurement id.
+  static uint32_t laneOf(Id id, uint32_t lanes) { return static_cast<uint32_t>(id % lanes); }
   ~Page();
 
   /// mapped file size.
@@ -63,6 +95,10 @@ public:
   std::string fileName() const;
   std::string index_fileName() const;
   std::string writewindow_fileName() const;
+  std::string postings_fileName() const;
+  /// move page files to filename, page stays mapped.
+  void rename(const std::string &filename);
+  void setLane(uint32_t lane, uint32_t lanes);
   /// min time of writed meas
   Time minTime() const;
   /// max time of writed meas
@@ -76,31 +112,57 @@ public:
   bool append(const Meas& value);
   size_t append(const Meas::PMeas begin, const size_t size);
   bool read(Meas::PMeas result, uint64_t position);
+  /// mapped values in positions [begin, end), nullptr if not all written.
+  const Meas *values(uint64_t begin, uint64_t end) const;
   PageReader_ptr readInterval(Time from, Time to);
-  PageReader_ptr readInterval(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to);
+  /// id_filter - compiled ids, if null, compiled from ids.
+  PageReader_ptr readInterval(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to,
+                              const IdFilter_ptr &id_filter = nullptr);
 
   PageReader_ptr readInTimePoint(Time time_point);
-  PageReader_ptr readInTimePoint(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point);
+  PageReader_ptr readInTimePoint(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point,
+                                 const IdFilter_ptr &id_filter = nullptr);
 
   // read from end to start while not find all meases in ids;
-  Meas::MeasList backwardRead(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point);
+  Meas::MeasList backwardRead(const IdFilter &ids, mdb::Flag source, mdb::Flag flag, Time time_point);
   /// if page openned to read, after read must call this method.
   /// if count of reader is zero, page automaticaly closed;
   void readComplete();
-  WriteWindow getWriteWindow();
+  /// shared snapshot of write window.
+  WriteWindow_ptr getWriteWindow();
   void        setWriteWindow(const WriteWindow&other);
 
   void flushWriteWindow();
+  /// write buffered index records and write window to disk.
+  void flush();
+  /// flush and force page data, index and write window to disk (msync/fsync).
+  void sync();
 private:
   PageReader_ptr readAll();
-  PageReader_ptr readFromToPos(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to, size_t begin, size_t end);
+  /// read values in positions, sorted.
+  PageReader_ptr readPositions(const IdArray &ids, const IdFilter_ptr &id_filter, mdb::Flag source, mdb::Flag flag,
+                               Time from, Time to, const std::vector<uint64_t> &positions);
+  void buildPostings();
+  /// in_time_range - all values in positions are in [from, to], time not checked.
+  PageReader_ptr readFromToPos(const IdArray &ids, const IdFilter_ptr &id_filter, mdb::Flag source, mdb::Flag flag,
+                               Time from, Time to, size_t begin, size_t end, bool in_time_range);
   Page(std::string fname);
   /// write empty header.
   void initHeader(char *data);
   void updateMinMax(const Meas& value);
+  void updateTimeSorted(const Meas& value);
   
+  /// map file and apply m_map_options.
+  void map(bool readOnly);
+  /// release page cache of full page.
+  void dropCache();
   void loadWriteWindow();
   void updateWriteWindow(const Meas&m);
+  /// slot of id changed since last flushWriteWindow.
+  void markWriteWindow(Id id);
+  /// map write window file with space for size values.
+  void mapWriteWindow(uint64_t size);
+  void unmapWriteWindow();
 protected:
   std::string *m_filename;
 
@@ -112,13 +174,51 @@ protected:
   Index  m_index;
 
   std::mutex m_lock;
+  bool m_readonly;
+  MapOptions m_map_options;
+  bool m_build_postings;
   WriteWindow m_writewindow;
+  WriteWindow_ptr m_ww_snapshot;
+
+  /// write window file mapped by slot, only dirty slots writed on flush.
+  /// slot of id is number of first appearance of id in page.
+  std::unordered_map<Id, uint64_t> m_ww_slots;
+  std::vector<Id> m_ww_slot_ids;
+  boost::interprocess::file_mapping *m_ww_file;
+  boost::interprocess::mapped_region *m_ww_region;
+  uint64_t m_ww_capacity;
+  std::vector<uint64_t> m_ww_dirty;
+  std::vector<bool> m_ww_dirty_flag;
 };
 
 bool HeaderIntervalCheck(Time from, Time to, Page::Header hdr);
 bool HeaderIdIntervalCheck(Id from, Id to, Page::Header hdr);
+/// is one of ids written to lane of page. empty ids - any.
+bool HeaderLaneCheck(const IdArray &ids, Page::Header hdr);
+
+/**
+* Block of readed values without copy. Values point to mapped page or, for
+* values not from page (write window, time point), to buffer of span.
+* Page reader (and mapping of its page) pinned while span holds it.
+*/
+struct MeasSpan : public utils::NonCopy {
+    MeasSpan();
+    /// count of values passed filters.
+    size_t size() const { return filtered ? selection.size() : count; }
+    const Meas &operator[](size_t i) const { return filtered ? values[selection[i]] : values[i]; }
+    /// release values and pin.
+    void clear();
+
+    const Meas *values;
+    size_t count;
+    /// if set, only values in positions of selection passed filters.
+    bool filtered;
+    std::vector<uint32_t> selection;
+    std::vector<Meas> buffer;
+    PageReader_ptr pin;
+};
 
-class PageReader: public utils::NonCopy{
+class PageReader: public utils::NonCopy, public std::enable_shared_from_this<PageReader>{
 public:
     static const  uint64_t defaultReadSize=1024;
     /// max count of measurements readed in on call of readNext
@@ -129,11 +229,16 @@ public:
     virtual bool isEnd() const=0;
     virtual void readNext(Meas::MeasList*output)=0;
     virtual void readAll(Meas::MeasList*output);
+    /// read next block to span. return false, if nothing readed.
+    virtual bool readNextSpan(MeasSpan*span);
+    /// set ids of reader and its filter, compiled from ids if null.
+    void setIds(const IdArray &ids, const IdFilter_ptr &filter = nullptr);
 
     IdArray ids;
+    IdFilter_ptr id_filter;
     mdb::Flag source;
     mdb::Flag flag;
-    WriteWindow prev_ww;
+    WriteWindow_ptr prev_ww;
 
 protected:
     bool checkValueFlags(const Meas&m)const;
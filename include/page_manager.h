@@ -4,6 +4,9 @@
 #include "utils.h"
 #include <string>
 #include <list>
+#include <vector>
+#include <mutex>
+#include <future>
 
 namespace mdb {
     /**
@@ -12,8 +15,9 @@ namespace mdb {
 	class PageManager : utils::NonCopy
 	{
 		static PageManager *m_instance;
-		PageManager() = default;
+		PageManager();
 	public:
+		~PageManager();
 		struct PageInfo
 		{
 			Page::Header header;
@@ -25,26 +29,65 @@ namespace mdb {
 		static void stop();
 		static PageManager* get();
 
-        /// get current openned page
-		Page::Page_ptr getCurPage();
+		/// count of writer lanes, each lane has own current page.
+		void setLanes(size_t lanes);
+		size_t lanes()const;
+
+        /// get current openned page of lane
+		Page::Page_ptr getCurPage(size_t lane = 0);
+        /// close current pages of all lanes
         void closeCurrentPage();
-		void createNewPage();
+		/// replace current page of lane by new one. old page closed without lock of manager.
+		void createNewPage(size_t lane = 0);
 
 		std::string getOldesPage()const;
+		/// last page of each lane
+		std::vector<std::string> lastPages()const;
 		std::string getNewPageUniqueName()const;
+		/// not existing page name in path.
+		static std::string uniquePageName(const std::string &path);
 
 		std::list<std::string> pageList() const;
+        /// open page as current page of its lane.
         Page::Page_ptr open(std::string path, bool readOnly=false);
 
 		std::vector<PageManager::PageInfo> pagesByTime()const;
+
+		/// keep one pre-created spare page per lane, created in background.
+		/// new current page is a rename of spare.
+		void setSparePages(bool flg);
+		bool sparePages()const;
+		/// mapping options of created and openned pages.
+		void setMapOptions(const MapOptions &options);
+		MapOptions mapOptions()const;
+		/// build postings of current and new pages, when they sealed.
+		void setBuildPostings(bool flg);
+		bool buildPostings()const;
     protected:
         std::string getOldesPage(const std::list<std::string> &pages)const;
+        /// create current page of lane. m_lock must be locked.
+        void createPage(size_t lane, const WriteWindow *wwindow);
+        /// remove page files. m_lock must be locked.
+        void removePage(const std::string &fname);
+        /// read page list from disk, if it not loaded. m_lock must be locked.
+        void loadPageList()const;
+        /// start creation of spare page of lane. m_lock must be locked.
+        void prepareSpare(size_t lane);
+        /// wait and remove spare pages. m_lock must be locked.
+        void dropSpares();
+        std::string spareName(size_t lane)const;
 	public:
 		uint64_t default_page_size;
 	protected:
 		std::string m_path;
-		Page::Page_ptr m_curpage;
+		std::vector<Page::Page_ptr> m_curpages;
+		bool m_spare_pages;
+		MapOptions m_map_options;
+		bool m_build_postings;
+		std::vector<std::future<Page::Page_ptr>> m_spares;
 		mutable std::list<std::string> m_page_list;
+		/// lanes create pages in parallel.
+		mutable std::mutex m_lock;
 		
 	};
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "meas.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mdb {
+const uint16_t postings_file_format = 1;
+
+/**
+* Inverted index of sealed page: id -> sorted positions of its values.
+* File: Header, Entry[ids_count] sorted by id, varint encoded deltas of positions.
+*/
+class Postings {
+public:
+  struct Header {
+    uint16_t format;
+    uint64_t ids_count;
+  };
+  struct Entry {
+    Id id;
+    /// offset of list in data.
+    uint64_t offset;
+    uint64_t count;
+  };
+  typedef std::shared_ptr<const Postings> Postings_ptr;
+
+  /// write postings of values to temporary file and rename it to fname,
+  /// so readers never see partly written file.
+  static void Build(const std::string &fname, const Meas *values, uint64_t count);
+  static Postings_ptr Load(const std::string &fname);
+
+  /// positions of values of ids, sorted.
+  std::vector<uint64_t> positions(const IdArray &ids) const;
+  size_t idsCount() const { return m_entries.size(); }
+
+  static void encode(uint64_t value, std::vector<uint8_t> *output);
+  /// throw, if value not ended before end.
+  static uint64_t decode(const uint8_t **pos, const uint8_t *end);
+
+private:
+  std::vector<Entry> m_entries;
+  std::vector<uint8_t> m_data;
+};
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 namespace mdb{
 
 class PageReaderInterval:public PageReader
@@ -10,16 +12,23 @@ public:
 
     virtual bool isEnd() const override;
     virtual void readNext(Meas::MeasList*output)override;
+    /// blocks of page returned as is, with selection of values passed filters.
+    virtual bool readNextSpan(MeasSpan*span)override;
     /// add {from,to} position to read.
     void addReadPos(uint64_t begin,uint64_t end);
 public:
     Time from;
     Time to;
         bool isWindowReader;
+    /// all read positions contain values in [from,to], check of time not needed.
+    bool inTimeRange;
 private:
-        bool checkValueInterval(const Meas&m)const;
+    /// scan next block of read positions. positions of passed values writed to selection.
+    const Meas *scanBlock(std::vector<uint32_t> *selection);
 private:
     std::list<from_to_pos> m_read_pos_list;
+    /// positions of block, selected by scan.
+    std::vector<uint32_t> m_selection;
     uint64_t m_cur_pos_begin;
     uint64_t m_cur_pos_end;
 
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "utils.h"
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+/**
+* Bounded lock-free multi producer single consumer ring.
+* Producers only do one CAS per push, consumer must be single at a time
+* (guard it by external lock). Capacity is rounded up to power of two.
+* look usage example in utils_test.cpp
+*/
+template <class T> class MPSCRing : public NonCopy {
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+public:
+  explicit MPSCRing(size_t capacity) {
+    size_t sz = 2;
+    while (sz < capacity) {
+      sz <<= 1;
+    }
+    m_mask = sz - 1;
+    m_cells.reset(new Cell[sz]);
+    for (size_t i = 0; i < sz; ++i) {
+      m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    m_enqueue_pos.store(0, std::memory_order_relaxed);
+    m_dequeue_pos = 0;
+  }
+
+  /// return false, if ring is full.
+  bool try_push(const T &value) {
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      Cell *cell = &m_cells[pos & m_mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+      if (dif == 0) {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+          cell->data = value;
+          cell->seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// return false, if ring is empty. only one consumer at a time.
+  bool try_pop(T *value) {
+    Cell *cell = &m_cells[m_dequeue_pos & m_mask];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(m_dequeue_pos + 1) < 0) {
+      return false;
+    }
+    *value = cell->data;
+    cell->seq.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+    m_dequeue_pos++;
+    return true;
+  }
+
+  size_t capacity() const { return m_mask + 1; }
+
+private:
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask;
+  // keep producer and consumer positions in different cache lines.
+  char m_pad0[64];
+  std::atomic<size_t> m_enqueue_pos;
+  char m_pad1[64];
+  size_t m_dequeue_pos;
+};
+}
@@ -2,33 +2,104 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <map>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <future>
 #include "page.h"
 #include "cache.h"
 #include "asyncworker.h"
+#include "ringbuffer.h"
 
 namespace mdb {
 
 const uint64_t defaultPageSize = sizeof(Page::Header) + sizeof(Meas) * 1000000;
 const size_t defaultcacheSize = 10000;
 const size_t defaultcachePoolSize = 100;
+const size_t defaultRingSize = 1 << 16;
+const uint64_t defaultSyncPeriod = 1000; // ms
+const size_t defaultReorderWindow = defaultcacheSize;
+
+/// when writed data forced to disk.
+enum class Durability {
+  /// no explicit sync (only on Close). data survive process crash after AsyncWriter wrote it to page,
+  /// on os crash all not synced by os data may be lost.
+  None,
+  /// current page, index and write window synced every N ms and on page rollover.
+  /// on os crash lost only values writed in last N ms.
+  Periodic,
+  /// page synced after each AsyncWriter batch, before cache returned to pool.
+  /// on os crash lost only values, what not yet written by AsyncWriter.
+  GroupCommit
+};
+
+/// how writers hand measurements over to the cache.
+enum class IngestMode {
+  /// each append takes the storage write lock.
+  Locked,
+  /// writers push to lock-free ring, ring drained to the cache by writer which own the write lock.
+  LockFreeRing,
+  /// each writer thread fill own cache, full caches sended to AsyncWriter separately.
+  ThreadShards
+};
 
 class StorageReader;
 typedef std::shared_ptr<StorageReader> StorageReader_ptr;
 
 class Storage;
 
+/// cache of one writer thread (see IngestMode::ThreadShards)
+struct CacheShard {
+  std::mutex lock;
+  std::thread::id owner;
+  Cache::PCache cache;
+};
+typedef std::shared_ptr<CacheShard> CacheShard_ptr;
+
 class AsyncWriter : public utils::AsyncWorker<Cache::PCache> {
 public:
-  AsyncWriter();
+  AsyncWriter(size_t lane = 0);
   void setStorage(Storage *mdb);
   void call(const Cache::PCache data) override;
 
 private:
   Storage *m_storage;
+  size_t m_lane;
 };
 
+/// page writer of part of ids (id % lanes), with own current page.
+struct WriterLane {
+  explicit WriterLane(size_t lane) : writer(lane) {}
+  /// writer and page sync exclusion.
+  std::mutex page_lock;
+  AsyncWriter writer;
+  /// values of lane from current cache.
+  std::vector<Meas> buffer;
+
+  /// value in reorder buffer and number of cache, which contained it.
+  struct ReorderItem {
+    Meas value;
+    uint64_t batch;
+  };
+  struct Batch {
+    size_t remaining;
+    WALHold_ptr hold;
+    AppendTickets tickets;
+  };
+  /// values waiting for older values from next caches, sorted by time.
+  /// emitted from front, so removal costs only count of emitted values.
+  std::deque<ReorderItem> reorder;
+  /// caches with values in reorder buffer.
+  std::map<uint64_t, Batch> batches;
+  uint64_t next_batch = 0;
+  /// tickets of batches, which left reorder buffer. released without page_lock.
+  AppendTickets done_tickets;
+};
+typedef std::unique_ptr<WriterLane> WriterLane_ptr;
+
 /**
 * Main class of mdb storage.
 */
@@ -45,9 +116,20 @@ public:
     bool havePage2Write() const;
     append_result append(const Meas& m);
     append_result append(const Meas::PMeas begin, const size_t meas_count);
+    /// append batch by columns, not set columns are 0.
+    append_result append(const MeasColumns &columns);
+    /// append values and call callback from writer thread, when all of them
+    /// written to pages (and pages synced, if sync is set). cache with last
+    /// values sended to writer at once, so callback not wait for next appends.
+    /// in time ordered mode reorder buffers of lanes written with this cache.
+    void appendAsync(const Meas::PMeas begin, const size_t meas_count,
+                     AppendTicket::Callback callback, bool sync = false);
+    std::future<append_result> appendAsync(const Meas::PMeas begin, const size_t meas_count,
+                                           bool sync = false);
 
     StorageReader_ptr readInterval(Time from, Time to);
     StorageReader_ptr readInterval(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to);
+    /// last appended values of ids, without flush of caches.
     Meas::MeasList curValues(const IdArray&ids);
 
     StorageReader_ptr readInTimePoint(Time time_point);
@@ -61,29 +143,149 @@ public:
     void enableCacheDynamicSize(bool flg);
     bool cacheDynamicSize() const;
 
+    /// what to do, when all caches are busy. memory_budget used by PoolPolicy::Grow
+    void setPoolPolicy(PoolPolicy policy, size_t memory_budget = 0);
+    PoolPolicy poolPolicy() const;
+    /// count of values dropped by PoolPolicy::Drop
+    uint64_t droppedCount() const;
+
     size_t getPoolSize()const;
     void setPoolSize(size_t sz);
 
     size_t getCacheSize()const;
     void setCacheSize(size_t sz);
 
+    /// period_ms used by Durability::Periodic
+    void setDurability(Durability mode, uint64_t period_ms = defaultSyncPeriod);
+    Durability durability() const;
+    /// force current page to disk.
+    void sync();
+    /// count of page syncs (rollover, sync(), sync tickets).
+    uint64_t syncedPagesCount() const;
+
+    /// log appended values, while they are in caches. logged values replayed by Open.
+    /// must be set before writers started.
+    void enableWal(bool flg, uint64_t segment_size = defaultWalSegmentSize);
+    bool walEnabled() const;
+
+    /// sort values by (time, id) before write to page. values of last reorder_window
+    /// values held in buffer, so values late at most that count are written in order.
+    /// reads and flushes write whole buffer to pages, values appended after it
+    /// and older than written ones are not ordered with them.
+    /// must be set before writers started.
+    void setTimeOrdered(bool flg, size_t reorder_window = defaultReorderWindow);
+    bool timeOrdered() const;
+
+    /// pre-create next page of each lane in background, so page rollover
+    /// not blocks writer on creation of file.
+    void setSparePages(bool flg);
+    bool sparePages() const;
+
+    /// build postings of sealed pages, reads of few ids use them.
+    void enablePostings(bool flg);
+    bool postingsEnabled() const;
+
+    /// mapping options of pages, openned or created after call.
+    void setMapOptions(const MapOptions &options);
+    MapOptions mapOptions() const;
+
+    /// count of parallel page writers. ids routed to lane by id % lanes.
+    /// must be set before writers started.
+    void setWriterLanes(size_t lanes);
+    size_t writerLanes() const;
+
+    /// must be set before writers started.
+    void setIngestMode(IngestMode mode, size_t ring_size = defaultRingSize);
+    IngestMode ingestMode() const;
+
     /// load current values of ids. return array of not founded measurements.
     IdArray loadCurValues(const IdArray&ids);
 private:
     Storage();
     void writeCache();
+    append_result appendToRing(const Meas::PMeas begin, const size_t meas_count);
+    /// move values from ring to cache. m_write_mutex must be locked.
+    /// lock - lock of m_write_mutex, released while waiting for free cache.
+    /// values of ring accepted by producers, so they never dropped by pool.
+    void drainRing(std::unique_lock<std::mutex> *lock = nullptr);
+    append_result appendToShard(const Meas::PMeas begin, const size_t meas_count);
+    CacheShard_ptr threadShard();
+    /// send all not empty shards to AsyncWriter.
+    void flushShards();
+    /// write values to cache, full caches sended to AsyncWriter. dropped values counted as ignored.
+    /// lock - lock of cache, released while waiting for free cache (see takeCache).
+    append_result appendToCache(Cache::PCache &cache, const Meas::PMeas begin,
+                                const size_t meas_count, const Time past_time,
+                                const AppendTicket_ptr &ticket = nullptr,
+                                std::unique_lock<std::mutex> *lock = nullptr);
+    /// release part of append. last part completes ticket.
+    void releaseTicket(const AppendTicket_ptr &ticket);
+    void releaseTickets(const AppendTickets &tickets);
+    /// sync current pages of all lanes.
+    void syncPages();
+    void syncPage(const Page::Page_ptr &page);
+    append_result appendToCache(Cache::PCache &cache, const MeasColumns &columns,
+                                const Time past_time, std::unique_lock<std::mutex> *lock = nullptr);
+    /// log values of cache from position 'from' to WAL.
+    void logToWal(Cache::PCache &cache, size_t from);
+    /// take cache from pool, if writer have no one. return false, if values must be dropped.
+    /// if lock is set, it unlocked while waiting for free cache, so writers of caches
+    /// and readers are not blocked. cache taken lazily, state guarded by lock may change.
+    /// if not can_drop, wait for cache under any policy.
+    bool takeCache(Cache::PCache &cache, std::unique_lock<std::mutex> *lock = nullptr,
+                   bool can_drop = true);
+    /// send cache to AsyncWriter. next cache taken from pool by next append.
+    void sendCache(Cache::PCache &cache);
+    /// called by AsyncWriter of lane.
+    void writeToPage(const Cache::PCache data, size_t lane);
+    /// append values to current pages of lane. lane page_lock must be locked.
+    void writeToLanePage(size_t lane, const Meas::PMeas values, size_t count);
+    /// sort values and merge them to reorder buffer of lane, write oldest to page.
+    void reorderToPage(size_t lane, const Meas::PMeas values, size_t count, const WALHold_ptr &hold,
+                       const AppendTickets &tickets);
+    /// write first count values of reorder buffer to page.
+    void emitReordered(size_t lane, size_t count);
+    /// write all values of reorder buffers.
+    void drainReorder();
+    void startWriters(size_t lanes);
+    void stopWriters();
+    bool writersBusy() const;
+    void pauseWriters();
+    void continueWriters();
+    void startSyncThread();
+    void stopSyncThread();
+    void syncThreadFunc();
     void flush_and_stop();
 protected:
     std::string m_path;
 
     std::mutex m_write_mutex;
     mdb::Cache::PCache m_cache;
-    AsyncWriter m_cache_writer;
-    CachePool m_cache_pool;
+    IngestMode m_ingest_mode;
+    std::unique_ptr<utils::MPSCRing<Meas>> m_ring;
+    uint64_t m_instance_id;
+    std::mutex m_shards_lock;
+    std::vector<CacheShard_ptr> m_shards;
+
+    Durability m_durability;
+    /// async appends with sync, which are not yet complete.
+    std::atomic<size_t> m_sync_tickets;
+    std::atomic<uint64_t> m_synced_pages;
+    uint64_t m_sync_period;
+    std::thread m_sync_thread;
+    std::mutex m_sync_mutex;
+    std::condition_variable m_sync_cond;
+    bool m_sync_stop;
+    std::unique_ptr<WAL> m_wal;
+    bool m_time_ordered;
+    size_t m_reorder_window;
+    std::vector<WriterLane_ptr> m_lanes;
+    CachePool_ptr m_cache_pool;
     CurValuesCache m_cur_values;
     Time m_past_time;
     bool m_closed;
     friend class mdb::Cache;
+    friend class mdb::AsyncWriter;
 };
 
 class StorageReader: public utils::NonCopy{
@@ -92,17 +294,30 @@ public:
     bool isEnd();
     void readNext(Meas::MeasList*output);
     void readAll(Meas::MeasList*output);
-    void addPage(std::string page_name);
+    /// read next not empty block without copy of values (see MeasSpan).
+    /// return false, if all readed.
+    bool readNextSpan(MeasSpan*span);
+    void addPage(std::string page_name, std::string prev_page = "");
 
     IdArray ids;
+    /// ids compiled once, shared by page readers.
+    IdFilter_ptr id_filter;
     mdb::Flag source;
     mdb::Flag flag;
     mdb::Time from;
     mdb::Time to;
     mdb::Time time_point;
-    std::string prev_interval_page;
+    /// options of storage for openned pages.
+    MapOptions map_options;
+private:
+    struct PageToRead {
+        std::string name;
+        /// page before interval in lane, source of write window.
+        std::string prev_page;
+    };
+    void openNextReader();
 private:
-    std::deque<std::string> m_pages;
+    std::deque<PageToRead> m_pages;
     PageReader_ptr m_current_reader;
 };
 }
@@ -35,6 +35,10 @@ std::list<boost::filesystem::path> ls(const std::string &path,
 bool rm(const std::string &rm_path);
 std::string filename(std::string fname); // without ex
 std::string parent_path(std::string fname);
+/// force file content to disk (fsync).
+bool sync_file(const std::string &fname);
+/// allocate disk blocks of file, so writes to its mapping not fail or stall on allocation.
+bool preallocate_file(const std::string &fname, uint64_t size);
 
 template <typename T> bool inInterval(T from, T to, T value) {
   return value >= from && value <= to;
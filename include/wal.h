@@ -0,0 +1,80 @@
+#pragma once
+
+#include "meas.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mdb {
+
+const uint64_t defaultWalSegmentSize = 64 * 1024 * 1024;
+const std::string wal_file_ext = ".wal";
+
+/**
+* Write ahead log of values, which are in caches and not yet written to page.
+* Log is a sequence of segment files <dir>/<number>.wal, each is a sequence of
+* records {RecordHeader, Meas[count]}. Writer remember segments of its values
+* (see append), and release them after values written to page. Not current
+* segment without pending writers is removed.
+*/
+class WAL : public utils::NonCopy {
+public:
+  typedef std::vector<uint64_t> Segments;
+
+  struct RecordHeader {
+    uint32_t count;
+    uint32_t checksum;
+  };
+
+  WAL(const std::string &dir, uint64_t segment_size = defaultWalSegmentSize);
+  ~WAL();
+  /// write record and add current segment to segments, if it not already there.
+  void append(const Meas::PMeas begin, const size_t count, Segments &segments);
+  /// values, written in segments, are on page.
+  void release(const Segments &segments);
+  /// force current segment to disk.
+  void sync();
+  void close();
+  /// segments on disk, including current.
+  size_t segmentsCount() const;
+
+  /// read all valid records of segments in dir. reading of segment stops on
+  /// first broken (torn by crash) record.
+  static Meas::MeasList readAll(const std::string &dir);
+  /// remove all segments in dir.
+  static void removeAll(const std::string &dir);
+  static uint32_t checksum(const Meas::PMeas begin, const size_t count);
+
+private:
+  void openSegment();
+  std::string segmentName(uint64_t number) const;
+  void removeIfDone(uint64_t number);
+
+private:
+  std::string m_dir;
+  uint64_t m_segment_size;
+  FILE *m_file;
+  uint64_t m_current;
+  uint64_t m_current_size;
+  /// segment number -> count of writers, whose values not yet on page.
+  std::map<uint64_t, size_t> m_pending;
+  mutable std::mutex m_lock;
+};
+
+/// WAL segments of values, released when last owner of hold destroyed.
+class WALHold : public utils::NonCopy {
+public:
+  WALHold(WAL *wal, WAL::Segments &&segments);
+  ~WALHold();
+
+private:
+  WAL *m_wal;
+  WAL::Segments m_segments;
+};
+typedef std::shared_ptr<WALHold> WALHold_ptr;
+}
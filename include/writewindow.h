@@ -1,21 +1,73 @@
 #pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <vector>
 #include "meas.h"
 
 namespace mdb
 {
-	class WriteWindow:public std::vector<Meas>
+	/**
+	* Last value of each id. Values stored in chunks of chunk_size ids, so memory
+	* depends on count of live ids, not on max id value. Chunk keeps only stored
+	* values, sparse id costs one value and chunk header (about 100 bytes).
+	* Chunks are shared between copies and cloned on write, so copy of window
+	* costs pointers of chunks.
+	*/
+	class WriteWindow
 	{
 	public:
-		WriteWindow()=default;
-		WriteWindow(WriteWindow::const_iterator begin, WriteWindow::const_iterator end);
-		explicit WriteWindow(const size_t &size);
-		WriteWindow(const WriteWindow& other);
-		void operator= (const WriteWindow& other);
+		static const size_t chunk_size = 64;
+
+		struct Chunk {
+			Chunk();
+			/// bit i is set, if value of id i of chunk is stored.
+			uint64_t mask;
+			/// values of set bits in order of bit: value of bit i is values[rank(i)].
+			std::vector<Meas> values;
+		};
+		typedef std::shared_ptr<Chunk> Chunk_ptr;
+		typedef std::map<Id, Chunk_ptr> Chunks;
+
+		/// iterates stored values in order of id.
+		class const_iterator {
+		public:
+			const_iterator(Chunks::const_iterator it, Chunks::const_iterator end);
+			const Meas& operator*()const;
+			const Meas* operator->()const;
+			const_iterator& operator++();
+			bool operator==(const const_iterator&other)const;
+			bool operator!=(const const_iterator&other)const;
+		private:
+			void skipEmpty();
+		private:
+			Chunks::const_iterator m_it;
+			Chunks::const_iterator m_end;
+			size_t m_pos;
+		};
+
+		WriteWindow();
+		WriteWindow(const WriteWindow& other)=default;
+		WriteWindow& operator= (const WriteWindow& other)=default;
 		~WriteWindow()=default;
 
-		Meas operator[](const size_t pos)const;
-		Meas&operator[](const size_t pos);
+		/// write m, if it newer than stored value of m.id. return true, if written.
+		bool update(const Meas&m);
+		/// value of id or Meas::empty().
+		Meas get(const Id id)const;
+		bool contains(const Id id)const;
+		/// count of stored values.
+		size_t size()const;
+		bool empty()const;
+		void clear();
+
+		const_iterator begin()const;
+		const_iterator end()const;
+	private:
+		Chunks m_chunks;
+		size_t m_size;
 	};
 
-}
\ No newline at end of file
+	/// immutable snapshot of write window.
+	typedef std::shared_ptr<const WriteWindow> WriteWindow_ptr;
+}
@@ -2,12 +2,18 @@
 #include "time.h"
 #include "storage.h"
 #include "utils.h"
+#include "time_utils.h"
+#include "kernels.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <thread>
 
 using namespace mdb;
 
-Cache::Cache(size_t size): m_max_size(size), m_size(0), m_index(0), m_sync(false),m_ds(nullptr) {
+Cache::Cache(size_t size): m_max_size(size), m_size(0), m_index(0), m_sync(false), m_pending_lanes(0), m_ds(nullptr) {
   m_meases = new Meas[size];
 }
 
@@ -22,13 +28,54 @@ void Cache::clear() {
   //	m_data.clear();
   m_size = 0;
   m_index = 0;
+  m_wal_segments.clear();
+  m_wal_hold = nullptr;
+  m_tickets.clear();
+}
+
+void Cache::addTicket(const AppendTicket_ptr &ticket) {
+  if (m_tickets.empty() || (m_tickets.back() != ticket)) {
+    ticket->addPending(1);
+    m_tickets.push_back(ticket);
+  }
+}
+
+AppendTicket::AppendTicket(Callback callback, bool sync_pages)
+    : result(), sync(sync_pages), m_pending(1), m_callback(callback) {}
+
+void AppendTicket::addPending(size_t count) {
+  m_pending += count;
+}
+
+bool AppendTicket::release() {
+  return m_pending.fetch_sub(1) == 1;
+}
+
+void AppendTicket::complete() {
+  if (m_callback) {
+    m_callback(result);
+  }
 }
 
 bool Cache::is_sync() const { return m_sync; }
 
 void Cache::sync_begin() { m_sync = true; }
 
-void Cache::sync_complete() { m_sync = false; }
+void Cache::sync_complete() {
+  m_sync = false;
+  auto pool = m_pool.lock();
+  if (pool != nullptr) {
+    pool->release(this->shared_from_this());
+  }
+}
+
+void Cache::setPendingLanes(size_t lanes) {
+  m_pending_lanes = lanes;
+}
+
+bool Cache::laneComplete() {
+  return m_pending_lanes.fetch_sub(1) == 1;
+}
 
 void Cache::setStorage(Storage*ds) {
 	m_ds = ds;
@@ -46,6 +93,9 @@ append_result Cache::append(const Meas &value, const Time past_time) {
   if (!isFull()) {
     m_meases[m_index] = value;
     // this->m_data[value.time].push_back(m_index);
+    if (m_ds != nullptr) {
+      m_ds->m_cur_values.writeValue(value);
+    }
     m_index++;
     m_size++;
 
@@ -58,34 +108,60 @@ append_result Cache::append(const Meas &value, const Time past_time) {
 }
 
 append_result Cache::append(const Meas::PMeas begin, const size_t size,
-							const Time past_time) {
+							const Time past_time, bool cur_values) {
   // std::lock_guard<std::mutex> lock(this->m_rw_lock);
-  size_t cap = this->m_max_size;
-  size_t to_write = 0;
-  if (cap > size) {
-    to_write = size;
-  } else if (cap == size) {
-    to_write = size;
-  } else if (cap < size) {
-    to_write = cap;
+  size_t cap = this->m_max_size - this->m_size;
+  size_t to_write = std::min(cap, size);
+
+  append_result res{};
+  res.writed = to_write;
+
+  size_t copied = to_write;
+  if (past_time == 0) {
+    std::copy(begin, begin + to_write, m_meases + m_index);
+  } else {
+    // one clock read per batch.
+    auto cur_time = TimeWork::CurrentUtcTime();
+    copied = kernels::filterPastTime(begin, to_write, cur_time, past_time, m_meases + m_index);
   }
+  res.ignored = to_write - copied;
+
+  if ((m_ds != nullptr) && cur_values) {
+    for (size_t i = m_index; i < m_index + copied; ++i) {
+      m_ds->m_cur_values.writeValue(m_meases[i]);
+    }
+  }
+  m_size += copied;
+  m_index += copied;
+
+  return res;
+}
+
+append_result Cache::append(const MeasColumns &columns, const size_t from,
+                            const Time past_time) {
+  size_t cap = this->m_max_size - this->m_size;
+  size_t to_write = std::min(cap, columns.count - from);
 
   append_result res{};
   res.writed = to_write;
 
-  for (size_t i = 0; i < to_write; ++i) {
-    if (!checkPastTime(begin[i].time, past_time)) {
-      res.ignored++;
-      continue;
+  auto cur_time = past_time == 0 ? 0 : TimeWork::CurrentUtcTime();
+  auto dst = m_meases + m_index;
+  size_t copied = 0;
+  for (size_t row = from; row < from + to_write; ++row) {
+    dst[copied] = columns.at(row);
+    // branchless: row is overwritten by next one, if it too old.
+    copied += checkPastTime(dst[copied].time, past_time, cur_time) ? 1 : 0;
+  }
+  res.ignored = to_write - copied;
+
+  if (m_ds != nullptr) {
+    for (size_t i = m_index; i < m_index + copied; ++i) {
+      m_ds->m_cur_values.writeValue(m_meases[i]);
     }
-	auto value = Meas{ begin[i] };
-    m_meases[m_index] = value;
-	if (m_ds != nullptr) {
-		m_ds->m_cur_values.writeValue(value);
-	}
-    m_size++;
-    m_index++;
   }
+  m_size += copied;
+  m_index += copied;
 
   return res;
 }
@@ -114,88 +190,94 @@ void Cache::setSize(const size_t sz) {
 }
 
 CachePool::CachePool(const size_t pool_size, const size_t cache_size)
-    : m_pool_size(pool_size), m_cache_size(cache_size),
-      m_default_pool_size(pool_size), /*m_default_cache_size(cache_size),*/
-      m_dynamic_size(false) {
-  m_recalc_period = (int)(pool_size / 3);
-  init_pool();
+    : m_pool_size(pool_size), m_cache_size(cache_size), m_total(0),
+      m_policy(PoolPolicy::Block), m_memory_budget(0), m_dropped(0) {}
+
+Cache::PCache CachePool::newCache() {
+  Cache::PCache c(new Cache(m_cache_size));
+  c->m_pool = this->shared_from_this();
+  m_total++;
+  return c;
 }
 
-void CachePool::init_pool() {
-  this->clear();
-  this->resize(m_pool_size);
-  for (size_t i = 0; i < m_pool_size; ++i) {
-    Cache::PCache c(new Cache(m_cache_size));
-    (*this)[i] = c;
+bool CachePool::canAllocate() const {
+  return (m_total < m_pool_size) || canGrow();
+}
+
+bool CachePool::canGrow() const {
+  if (m_policy != PoolPolicy::Grow) {
+    return false;
+  }
+  if (m_memory_budget == 0) {
+    return true;
   }
+  auto cache_bytes = m_cache_size * sizeof(Meas);
+  return (m_total + 1) * cache_bytes <= m_memory_budget;
 }
 
-void CachePool::enableDynamicSize(bool flg) { m_dynamic_size = flg; }
+bool CachePool::haveCache() const {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return !m_free.empty() || canAllocate();
+}
 
-bool CachePool::dynamicSize() const { return m_dynamic_size; }
+Cache::PCache CachePool::tryGetCache() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_free.empty()) {
+    auto result = m_free.back();
+    m_free.pop_back();
+    return result;
+  }
+  if (canAllocate()) {
+    return newCache();
+  }
+  return nullptr;
+}
 
-bool CachePool::haveCache() {
-  auto c = this->getCache();
-  return c != nullptr;
+void CachePool::waitCache() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (m_free.empty() && !canAllocate()) {
+    m_have_free.wait(lock);
+  }
 }
 
 Cache::PCache CachePool::getCache() {
-  m_recalc_period--;
-  Cache::PCache result = nullptr;
-  int count_of_free = 0;
-  for (size_t i = 0; i < this->size(); i++) {
-    if (!this->at(i)->is_sync()) {
-      result = this->at(i);
-      count_of_free++;
-    }
-  }
-
-  if (m_dynamic_size) {
-    if (result == nullptr) {
-      this->setPoolSize((int)(m_pool_size * 1.5));
-      this->setCacheSize((int)(m_cache_size * 1.5));
-      m_recalc_period = static_cast<int>(m_pool_size);
-      return this->getCache();
-    }
-
-    // FIX more smartable method.
-    if (m_recalc_period <= 0) {
-      if ((count_of_free >= (int)(m_pool_size / 2) &&
-           (m_pool_size > m_default_pool_size))) { // free >= 50%
-        size_t new_size = (size_t)m_pool_size / 2;
-        if (new_size < m_default_pool_size) {
-          new_size = m_default_pool_size;
-        }
-        //                logger<<"cache pool down to "<<new_size;
-        this->setPoolSize(new_size);
-        //                new_size=m_cache_size*0.75;
-        //                if (new_size<m_default_cache_size){
-        //                    new_size=m_default_cache_size;
-        //                }
-        //                this->setCacheSize(new_size);
-        //                logger<<"cache up to "<<new_size;
-        m_recalc_period = (int)m_pool_size / 2;
-      }
-
-      if (count_of_free <= m_pool_size * 0.85) { // free<=85%
-        size_t new_size = m_pool_size * 2;
-        //                logger<<"cache pool up to "<<new_size;
-        this->setPoolSize(new_size);
-        // logger<<"cache up to "<<(int)m_cache_size*1.5;
-        // this->setCacheSize((int)m_cache_size*1.5);
-        m_recalc_period = (int)m_pool_size / 2;
-      }
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (m_free.empty()) {
+    if (canAllocate()) {
+      return newCache();
+    }
+    if (m_policy == PoolPolicy::Drop) {
+      return nullptr;
     }
+    m_have_free.wait(lock);
   }
+  auto result = m_free.back();
+  m_free.pop_back();
   return result;
 }
 
+void CachePool::release(const Cache::PCache &c) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_total > m_pool_size && m_policy != PoolPolicy::Grow) {
+    // pool was shrinked, while cache was in use.
+    c->m_pool.reset();
+    m_total--;
+    return;
+  }
+  if (c->m_max_size != m_cache_size) {
+    c->setSize(m_cache_size);
+  }
+  c->clear();
+  m_free.push_back(c);
+  m_have_free.notify_one();
+}
+
 void CachePool::setCacheSize(const size_t sz) {
+  std::lock_guard<std::mutex> lock(m_lock);
   m_cache_size = sz;
-  for (size_t i = 0; i < this->size(); i++) {
-    if (!this->at(i)->is_sync()) {
-      this->at(i)->setSize(sz);
-    }
+  for (auto &c : m_free) {
+    c->setSize(sz);
+    c->clear();
   }
 }
 
@@ -204,31 +286,230 @@ size_t CachePool::getCacheSize() const{
 }
 
 void CachePool::setPoolSize(const size_t sz) {
+  std::lock_guard<std::mutex> lock(m_lock);
   m_pool_size = sz;
-  this->init_pool();
+  while ((m_total > m_pool_size) && !m_free.empty()) {
+    m_free.back()->m_pool.reset();
+    m_free.pop_back();
+    m_total--;
+  }
+  m_have_free.notify_all();
 }
 
 size_t CachePool::getPoolSize()const{
     return m_pool_size;
 }
 
+void CachePool::setPolicy(PoolPolicy policy, size_t memory_budget) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_policy = policy;
+  m_memory_budget = memory_budget;
+  m_have_free.notify_all();
+}
 
-CurValuesCache::CurValuesCache() :m_values() {
+PoolPolicy CachePool::policy() const {
+  return m_policy;
+}
+
+uint64_t CachePool::droppedCount() const {
+  return m_dropped;
+}
+
+void CachePool::addDropped(size_t count) {
+  m_dropped += count;
+}
+
+void CachePool::enableDynamicSize(bool flg) {
+  this->setPolicy(flg ? PoolPolicy::Grow : PoolPolicy::Block);
+}
+
+bool CachePool::dynamicSize() const { return m_policy == PoolPolicy::Grow; }
+
+
+namespace {
+/// key of empty slot. value of this id stored in Table::max_id.
+const uint64_t empty_key = ~uint64_t(0);
+}
+
+void CurValuesCache::initSlot(Slot &slot) {
+  slot.seq.store(0, std::memory_order_relaxed);
+  slot.key.store(empty_key, std::memory_order_relaxed);
+  for (size_t w = 0; w < meas_words; ++w) {
+    slot.value[w].store(0, std::memory_order_relaxed);
+  }
+}
+
+CurValuesCache::Table::Table(size_t capacity) : size(0), moved(false) {
+  size_t sz = 2;
+  while (sz < capacity) {
+    sz <<= 1;
+  }
+  mask = sz - 1;
+  max_size = sz - sz / 4;
+  slots.reset(new Slot[sz]);
+  for (size_t i = 0; i < sz; ++i) {
+    initSlot(slots[i]);
+  }
+  initSlot(max_id);
+}
+
+size_t CurValuesCache::Table::home(Id id) const {
+  // fibonacci hashing, dense ids go to neighbor slots.
+  return static_cast<size_t>(id * 11400714819323198485ull) & mask;
+}
+
+CurValuesCache::Slot *CurValuesCache::Table::findSlot(Id id, bool insert) {
+  if (id == empty_key) {
+    return (insert || (max_id.seq.load(std::memory_order_acquire) != 0)) ? &max_id : nullptr;
+  }
+  for (size_t i = home(id), probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+    auto &slot = slots[i];
+    auto key = slot.key.load(std::memory_order_acquire);
+    if (key == id) {
+      return &slot;
+    }
+    if (key != empty_key) {
+      continue;
+    }
+    if (!insert) {
+      return nullptr;
+    }
+    if (size.fetch_add(1) >= max_size) {
+      size.fetch_sub(1);
+      return nullptr;
+    }
+    if (slot.key.compare_exchange_strong(key, id, std::memory_order_acq_rel)) {
+      return &slot;
+    }
+    // slot claimed by other writer, may be for the same id.
+    size.fetch_sub(1);
+    if (key == id) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+CurValuesCache::CurValuesCache(size_t capacity) {
+  m_tables.emplace_back(new Table(capacity));
+  m_table.store(m_tables.back().get());
+}
+
+bool CurValuesCache::readSlot(const Slot &slot, Meas *output) {
+  uint64_t words[meas_words];
+  while (true) {
+    auto before = slot.seq.load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (size_t w = 0; w < meas_words; ++w) {
+      words[w] = slot.value[w].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == before) {
+      if (before == 0) {
+        // claimed, but value not yet writed.
+        return false;
+      }
+      memcpy(output, words, sizeof(Meas));
+      return true;
+    }
+  }
+}
+
+void CurValuesCache::writeSlot(Slot &slot, const Meas &v) {
+  uint64_t words[meas_words];
+  memcpy(words, &v, sizeof(Meas));
+  const size_t time_word = offsetof(Meas, time) / sizeof(uint64_t);
+
+  // lock slot: even -> odd.
+  auto seq = slot.seq.load(std::memory_order_relaxed);
+  while ((seq & 1) || !slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+    seq = slot.seq.load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  if ((seq == 0) || (slot.value[time_word].load(std::memory_order_relaxed) <= v.time)) {
+    for (size_t w = 0; w < meas_words; ++w) {
+      slot.value[w].store(words[w], std::memory_order_relaxed);
+    }
+  }
+  slot.seq.store(seq + 2, std::memory_order_release);
 }
 
 void CurValuesCache::writeValue(const mdb::Meas&v) {
-	this->m_values.insert(std::make_pair(v.id, v));
+  auto table = m_table.load(std::memory_order_acquire);
+  while (true) {
+    auto slot = table->findSlot(v.id, true);
+    if (slot == nullptr) {
+      table = this->grow(table);
+      continue;
+    }
+    writeSlot(*slot, v);
+    // pairs with fence of grow: value is copied by grow or writed again here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!table->moved.load(std::memory_order_relaxed)) {
+      return;
+    }
+    // wait end of moving and repeat write in new table.
+    { std::lock_guard<std::mutex> lock(m_grow_lock); }
+    table = m_table.load(std::memory_order_acquire);
+  }
+}
+
+CurValuesCache::Table *CurValuesCache::grow(Table *table) {
+  std::lock_guard<std::mutex> lock(m_grow_lock);
+  auto current = m_table.load(std::memory_order_acquire);
+  if (current != table) {
+    return current;
+  }
+  std::unique_ptr<Table> bigger(new Table((table->mask + 1) * 2));
+  table->moved.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  Meas value;
+  for (size_t i = 0; i <= table->mask; ++i) {
+    if (readSlot(table->slots[i], &value)) {
+      writeSlot(*bigger->findSlot(value.id, true), value);
+    }
+  }
+  if (readSlot(table->max_id, &value)) {
+    writeSlot(bigger->max_id, value);
+  }
+  m_table.store(bigger.get(), std::memory_order_release);
+  m_tables.push_back(std::move(bigger));
+  return m_tables.back().get();
 }
 
 mdb::Meas::MeasList CurValuesCache::readValue(const mdb::IdArray&ids)const {
 	Meas::MeasList result;
-	for (auto id : ids) {
-		auto it = m_values.find(id);
-		if (it != m_values.end()) {
-			result.push_back(it->second);
-        }else{
-            result.push_back(Meas::empty());
-        }
+	auto table = m_table.load(std::memory_order_acquire);
+	const size_t prefetch_distance = 8;
+#ifdef __GNUC__
+	for (size_t i = 0; (i < prefetch_distance) && (i < ids.size()); ++i) {
+		__builtin_prefetch(&table->slots[table->home(ids[i])]);
+	}
+#endif
+	for (size_t i = 0; i < ids.size(); ++i) {
+#ifdef __GNUC__
+		if (i + prefetch_distance < ids.size()) {
+			__builtin_prefetch(&table->slots[table->home(ids[i + prefetch_distance])]);
+		}
+#endif
+		Meas value = Meas::empty();
+		auto slot = table->findSlot(ids[i], false);
+		if (slot != nullptr) {
+			readSlot(*slot, &value);
+		}
+		result.push_back(value);
 	}
 	return result;
 }
+
+size_t CurValuesCache::size()const {
+	auto table = m_table.load(std::memory_order_acquire);
+	return table->size.load() + (table->max_id.seq.load() != 0 ? 1 : 0);
+}
+
+size_t CurValuesCache::capacity()const {
+	return m_table.load(std::memory_order_acquire)->mask + 1;
+}
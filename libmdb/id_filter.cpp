@@ -0,0 +1,44 @@
+#include "id_filter.h"
+#include <algorithm>
+
+using namespace mdb;
+
+const uint64_t IdFilter::bitmap_density;
+const uint64_t IdFilter::bitmap_min_range;
+
+IdFilter::IdFilter() : m_kind(Kind::All), m_min(0), m_range(0) {}
+
+IdFilter_ptr IdFilter::all() {
+	static const IdFilter_ptr result = std::make_shared<const IdFilter>();
+	return result;
+}
+
+IdFilter_ptr IdFilter::make(const IdArray &ids) {
+	if (ids.empty()) {
+		return all();
+	}
+	return std::make_shared<const IdFilter>(ids);
+}
+
+IdFilter::IdFilter(const IdArray &ids) : IdFilter() {
+	if (ids.empty()) {
+		return;
+	}
+	auto minmax = std::minmax_element(ids.cbegin(), ids.cend());
+	m_min = *minmax.first;
+	uint64_t span = *minmax.second - m_min;
+	uint64_t max_range = std::max(bitmap_min_range, uint64_t(ids.size()) * bitmap_density);
+	if (span < max_range) {
+		m_kind = Kind::Bitmap;
+		m_range = span + 1;
+		m_bits.resize((m_range + 63) / 64, 0);
+		for (auto id : ids) {
+			uint64_t offset = id - m_min;
+			m_bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+		}
+	} else {
+		m_kind = Kind::Hash;
+		m_set.reserve(ids.size());
+		m_set.insert(ids.cbegin(), ids.cend());
+	}
+}
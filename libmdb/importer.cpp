@@ -0,0 +1,136 @@
+#include "importer.h"
+#include "page_manager.h"
+#include "exception.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+using namespace mdb;
+
+Importer::Importer(const std::string &path, uint64_t page_size)
+    : m_path(path), m_page_size(page_size), m_pages(0), m_postings(false) {
+  if (m_page_size <= sizeof(Page::Header)) {
+    throw MAKE_EXCEPTION("Importer: page size is too small");
+  }
+  m_chunk_size = (m_page_size - sizeof(Page::Header)) / sizeof(Meas);
+  m_chunk.reserve(m_chunk_size);
+  if (!boost::filesystem::exists(m_path)) {
+    boost::filesystem::create_directories(m_path);
+  }
+}
+
+Importer::~Importer() {
+  try {
+    this->close();
+  } catch (std::exception &ex) {
+    logger_fatal("Importer: close error: " << ex.what());
+  }
+}
+
+void Importer::append(const Meas::PMeas begin, const size_t count) {
+  size_t pos = 0;
+  while (pos < count) {
+    auto to_copy = std::min(count - pos, m_chunk_size - m_chunk.size());
+    m_chunk.insert(m_chunk.end(), begin + pos, begin + pos + to_copy);
+    pos += to_copy;
+    if (m_chunk.size() == m_chunk_size) {
+      this->writeChunk();
+    }
+  }
+}
+
+void Importer::close() {
+  if (!m_chunk.empty()) {
+    this->writeChunk();
+  }
+}
+
+void Importer::writeChunk() {
+  std::sort(m_chunk.begin(), m_chunk.end(), MeasCmpByTime());
+
+  auto page = Page::Create(PageManager::uniquePageName(m_path), m_page_size);
+  page->setWriteWindow(m_ww);
+  page->setBuildPostings(m_postings);
+  auto writed = page->append(m_chunk.data(), m_chunk.size());
+  if (writed != m_chunk.size()) {
+    throw MAKE_EXCEPTION("Importer: page overflow");
+  }
+  for (auto &m : m_chunk) {
+    m_ww.update(m);
+  }
+  // import reports success only for values on disk.
+  page->sync();
+  page->close();
+  m_pages++;
+  m_chunk.clear();
+}
+
+size_t Importer::parseCsv(const char *begin, const char *end, Meas::MeasArray *output) {
+  size_t skipped = 0;
+  auto line = begin;
+  while (line < end) {
+    auto line_end = std::find(line, end, '\n');
+    uint64_t fields[5] = {0, 0, 0, 0, 0};
+    size_t count = 0;
+    auto pos = line;
+    while ((pos < line_end) && (count < 5)) {
+      char *field_end = nullptr;
+      fields[count] = std::strtoull(pos, &field_end, 10);
+      if ((field_end == pos) || (field_end > line_end)) {
+        break;
+      }
+      count++;
+      pos = field_end;
+      if ((pos < line_end) && (*pos == ',')) {
+        pos++;
+      }
+    }
+    if (count >= 3) {
+      Meas m;
+      m.id = fields[0];
+      m.time = fields[1];
+      m.value = fields[2];
+      m.source = fields[3];
+      m.flag = fields[4];
+      output->push_back(m);
+    } else if (line_end != line) {
+      skipped++;
+    }
+    line = line_end + 1;
+  }
+  return skipped;
+}
+
+size_t Importer::parseCsv(const char *begin, const char *end, size_t threads,
+                          Meas::MeasArray *output) {
+  if (threads <= 1) {
+    return parseCsv(begin, end, output);
+  }
+  // part boundaries moved to line ends.
+  std::vector<const char *> bounds{begin};
+  auto part_size = size_t(end - begin) / threads;
+  for (size_t i = 1; i < threads; ++i) {
+    auto pos = std::max(bounds.back(), begin + i * part_size);
+    pos = std::find(pos, end, '\n');
+    bounds.push_back(pos == end ? end : pos + 1);
+  }
+  bounds.push_back(end);
+
+  std::vector<Meas::MeasArray> parts(threads);
+  std::vector<size_t> skipped(threads, 0);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i]() { skipped[i] = parseCsv(bounds[i], bounds[i + 1], &parts[i]); });
+  }
+  size_t result = 0;
+  for (size_t i = 0; i < threads; ++i) {
+    workers[i].join();
+    output->insert(output->end(), parts[i].begin(), parts[i].end());
+    result += skipped[i];
+  }
+  return result;
+}
@@ -4,29 +4,30 @@
 #include "utils.h"
 #include "search.h"
 
-#include <boost/interprocess/file_mapping.hpp>
-#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
 
 using namespace mdb;
 
-namespace bi = boost::interprocess;
-
-Index::Index():m_fname("not_set") {
+Index::Index():m_fname("not_set"), m_file(nullptr), m_blocks(), m_loaded(false), m_dirty_from(0), m_shared(nullptr) {
 }
 
 
 Index::~Index() {
+	try {
+		this->flush();
+	} catch (std::exception &ex) {
+		logger_fatal("Index::~Index: " << ex.what());
+	}
+	if (m_file != nullptr) {
+		fclose(m_file);
+		m_file = nullptr;
+	}
 }
 
 void Index::setFileName(const std::string& fname) {
 	m_fname = fname;
 	if (!boost::filesystem::exists(fname)) {
-		IndexHeader ih;
-		ih.format = index_file_format;
-
-		FILE *pFile = std::fopen(this->fileName().c_str(), "ab");
-		fwrite(&ih, sizeof(IndexHeader), 1, pFile);
-		fclose(pFile);
+		this->reset();
 	}
 }
 
@@ -34,71 +35,293 @@ std::string Index::fileName()const {
 	return m_fname;
 }
 
-void Index::writeIndexRec(const Index::IndexRecord &rec) {
-	FILE *pFile = std::fopen(this->fileName().c_str(), "ab");
+void Index::reset() {
+	if (m_file != nullptr) {
+		fclose(m_file);
+		m_file = nullptr;
+	}
+	IndexHeader ih;
+	ih.format = index_file_format;
 
-	try {
-		fwrite(&rec, sizeof(rec), 1, pFile);
-	} catch (std::exception &ex) {
-		auto message = ex.what();
+	FILE *pFile = std::fopen(this->fileName().c_str(), "wb");
+	if (pFile == nullptr) {
+		throw MAKE_EXCEPTION("can't create index file: " + this->fileName());
+	}
+	fwrite(&ih, sizeof(IndexHeader), 1, pFile);
+	fclose(pFile);
+
+	m_blocks.clear();
+	m_loaded = true;
+	m_dirty_from = 0;
+}
+
+void Index::CheckFormat(FILE *pFile, const std::string &fname) {
+	IndexHeader ih;
+	if ((fread(&ih, sizeof(IndexHeader), 1, pFile) != 1) || (ih.format != index_file_format)) {
 		fclose(pFile);
-		throw MAKE_EXCEPTION(message);
+		throw MAKE_EXCEPTION("unknown index format: " + fname);
+	}
+}
+
+void Index::loadBlocks() {
+	if (m_loaded) {
+		return;
+	}
+	m_loaded = true;
+	FILE *pFile = std::fopen(this->fileName().c_str(), "rb");
+	if (pFile == nullptr) {
+		throw MAKE_EXCEPTION("can't open index file: " + this->fileName());
+	}
+	CheckFormat(pFile, this->fileName());
+	IndexRecord rec;
+	while (fread(&rec, sizeof(IndexRecord), 1, pFile) == 1) {
+		m_blocks.push_back(rec);
 	}
 	fclose(pFile);
+	m_dirty_from = m_blocks.size();
 }
 
-std::list<Index::IndexRecord> Index::findInIndex(const IdArray &ids, Time from, Time to) const {
-	std::list<Index::IndexRecord> result;
+size_t Index::size() {
+	this->loadBlocks();
+	return m_blocks.size();
+}
 
-	try {
+Index::IndexRecord* Index::blockFor(uint64_t pos) {
+	if (!m_blocks.empty()) {
+		auto last = &m_blocks.back();
+		if ((last->pos + last->count == pos) && (last->pos / index_block_size == pos / index_block_size)) {
+			m_dirty_from = std::min(m_dirty_from, m_blocks.size() - 1);
+			return last;
+		}
+	}
+	return nullptr;
+}
 
-		bi::file_mapping i_file(this->fileName().c_str(), bi::read_write);
-		bi::mapped_region region(i_file, bi::read_write);
+void Index::append(const Meas &value, uint64_t pos) {
+	this->loadBlocks();
+	auto block = this->blockFor(pos);
+	if (block == nullptr) {
+		IndexRecord rec;
+		rec.pos = pos;
+		rec.count = 1;
+		rec.minTime = rec.maxTime = value.time;
+		rec.minId = rec.maxId = value.id;
+		m_dirty_from = std::min(m_dirty_from, m_blocks.size());
+		m_blocks.push_back(rec);
+	} else {
+		block->count++;
+		block->minTime = std::min(block->minTime, value.time);
+		block->maxTime = std::max(block->maxTime, value.time);
+		block->minId = std::min(block->minId, value.id);
+		block->maxId = std::max(block->maxId, value.id);
+	}
+}
+
+void Index::append(const Meas::PMeas begin, const size_t count, uint64_t pos) {
+	this->loadBlocks();
+	size_t i = 0;
+	while (i < count) {
+		auto cur_pos = pos + i;
+		// values from i to chunk_end lays in one block.
+		auto block_end = (cur_pos / index_block_size + 1) * index_block_size;
+		auto chunk_end = std::min(count, size_t(i + (block_end - cur_pos)));
 
-		
-		IndexRecord *i_data = (IndexRecord *)((char*)region.get_address()+sizeof(Index::IndexHeader));
-		auto fsize = region.get_size();
+		auto block = this->blockFor(cur_pos);
+		if (block == nullptr) {
+			IndexRecord rec;
+			rec.pos = cur_pos;
+			rec.count = 0;
+			rec.minTime = rec.maxTime = begin[i].time;
+			rec.minId = rec.maxId = begin[i].id;
+			m_dirty_from = std::min(m_dirty_from, m_blocks.size());
+			m_blocks.push_back(rec);
+			block = &m_blocks.back();
+		}
+		for (; i < chunk_end; ++i) {
+			block->minTime = std::min(block->minTime, begin[i].time);
+			block->maxTime = std::max(block->maxTime, begin[i].time);
+			block->minId = std::min(block->minId, begin[i].id);
+			block->maxId = std::max(block->maxId, begin[i].id);
+		}
+		block->count = pos + chunk_end - block->pos;
+	}
+}
 
-		bool index_filter = false;
-		Id minId = 0;
-		Id maxId = 0;
-		if (ids.size() != 0) {
-			index_filter = true;
-			minId = *std::min_element(ids.cbegin(), ids.cend());
-			maxId = *std::max_element(ids.cbegin(), ids.cend());
+void Index::flush() {
+	if (m_dirty_from >= m_blocks.size()) {
+		return;
+	}
+	if (m_file == nullptr) {
+		m_file = std::fopen(this->fileName().c_str(), "r+b");
+		if (m_file == nullptr) {
+			throw MAKE_EXCEPTION("can't open index file: " + this->fileName());
 		}
+	}
+	auto to_write = m_blocks.size() - m_dirty_from;
+	auto offset = sizeof(IndexHeader) + m_dirty_from * sizeof(IndexRecord);
+	if (fseek(m_file, (long)offset, SEEK_SET) != 0) {
+		throw MAKE_EXCEPTION("index seek error: " + this->fileName());
+	}
+	auto writed = fwrite(&m_blocks[m_dirty_from], sizeof(IndexRecord), to_write, m_file);
+	if ((writed != to_write) || (fflush(m_file) != 0)) {
+		throw MAKE_EXCEPTION("index write error: " + this->fileName());
+	}
+	m_dirty_from = m_blocks.size();
+}
+
+void Index::sync() {
+	this->flush();
+	if (m_file != nullptr) {
+		utils::sync_file(this->fileName());
+	}
+}
 
-       		
-		Index::IndexRecord prev_value;
-		bool first = true;
-        for (size_t pos = 0; pos<fsize / sizeof(IndexRecord); pos++) {
-			Index::IndexRecord rec;
-
-			rec = i_data[pos];
-
-			if (utils::inInterval(from, to, rec.minTime) ||	utils::inInterval(from, to, rec.maxTime)) {
-				if ((!index_filter) || (utils::inInterval(minId, maxId, rec.minId) || utils::inInterval(minId, maxId, rec.maxId))) {
-					if (!first) {
-						if ((prev_value.pos + prev_value.count) == rec.pos) {
-							prev_value.count += rec.count;
-						} else {
-							result.push_back(prev_value);
-							prev_value = rec;
-						}
+std::list<Index::IndexRecord> Index::findInIndex(const IdArray &ids, Time from, Time to) {
+	std::list<Index::IndexRecord> result;
+
+	const IndexRecord *records = nullptr;
+	size_t first_block = 0;
+	size_t last_block = 0;
+	if (m_shared != nullptr) {
+		records = m_shared->records.data();
+		auto &max_prefix = m_shared->maxTimePrefix;
+		auto &min_suffix = m_shared->minTimeSuffix;
+		// blocks before first_block end before from, blocks after last_block start after to.
+		first_block = std::lower_bound(max_prefix.begin(), max_prefix.end(), from) - max_prefix.begin();
+		last_block = std::upper_bound(min_suffix.begin(), min_suffix.end(), to) - min_suffix.begin();
+	} else {
+		this->loadBlocks();
+		records = m_blocks.data();
+		last_block = m_blocks.size();
+	}
+
+	bool index_filter = false;
+	Id minId = 0;
+	Id maxId = 0;
+	if (ids.size() != 0) {
+		index_filter = true;
+		minId = *std::min_element(ids.cbegin(), ids.cend());
+		maxId = *std::max_element(ids.cbegin(), ids.cend());
+	}
+
+	Index::IndexRecord prev_value;
+	bool first = true;
+	for (size_t pos = first_block; pos < last_block; pos++) {
+		const Index::IndexRecord &rec = records[pos];
+
+		// block [minTime,maxTime] intersects with [from,to]
+		if ((rec.minTime <= to) && (rec.maxTime >= from)) {
+			if ((!index_filter) || ((rec.minId <= maxId) && (rec.maxId >= minId))) {
+				if (!first) {
+					if ((prev_value.pos + prev_value.count) == rec.pos) {
+						prev_value.count += rec.count;
 					} else {
-						first = false;
+						result.push_back(prev_value);
 						prev_value = rec;
 					}
+				} else {
+					first = false;
+					prev_value = rec;
 				}
 			}
 		}
-		if (!first) {
-			result.push_back(prev_value);
+	}
+	if (!first) {
+		result.push_back(prev_value);
+	}
+	return result;
+}
+
+void Index::useShared(uint64_t values_count) {
+	m_shared = IndexCache::get()->blocks(this->fileName(), values_count);
+}
+
+Index::Blocks_ptr Index::ReadBlocks(const std::string &fname) {
+	auto result = std::make_shared<Blocks>();
+	FILE *pFile = std::fopen(fname.c_str(), "rb");
+	if (pFile == nullptr) {
+		throw MAKE_EXCEPTION("can't open index file: " + fname);
+	}
+	CheckFormat(pFile, fname);
+	IndexRecord rec;
+	while (fread(&rec, sizeof(IndexRecord), 1, pFile) == 1) {
+		result->records.push_back(rec);
+	}
+	fclose(pFile);
+
+	auto count = result->records.size();
+	result->maxTimePrefix.resize(count);
+	result->minTimeSuffix.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		auto t = result->records[i].maxTime;
+		result->maxTimePrefix[i] = i == 0 ? t : std::max(t, result->maxTimePrefix[i - 1]);
+	}
+	for (size_t i = count; i > 0; --i) {
+		auto t = result->records[i - 1].minTime;
+		result->minTimeSuffix[i - 1] = i == count ? t : std::min(t, result->minTimeSuffix[i]);
+	}
+	return result;
+}
+
+IndexCache *IndexCache::get() {
+	static IndexCache instance;
+	return &instance;
+}
+
+Index::Blocks_ptr IndexCache::blocks(const std::string &fname, uint64_t values_count) {
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto it = m_blocks.find(fname);
+		if (it != m_blocks.end()) {
+			return it->second;
 		}
-	} catch (std::exception &ex) {
-		auto message = ex.what();
-		throw MAKE_EXCEPTION(message);
 	}
+	// readed without lock, concurrent readers of same page insert equal blocks.
+	auto result = Index::ReadBlocks(fname);
+	auto &records = result->records;
+	if (records.empty() || (records.back().pos + records.back().count != values_count)) {
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_blocks.insert(std::make_pair(fname, result));
+	return result;
+}
 
+Postings::Postings_ptr IndexCache::postings(const std::string &fname) {
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto it = m_postings.find(fname);
+		if (it != m_postings.end()) {
+			return it->second;
+		}
+	}
+	auto result = Postings::Load(fname);
+	// postings of page may be not built yet, so missing file is not cached.
+	if (result != nullptr) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_postings.insert(std::make_pair(fname, result));
+	}
 	return result;
 }
+
+void IndexCache::erase(const std::string &fname) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_blocks.erase(fname);
+	m_postings.erase(fname);
+}
+
+void IndexCache::erasePage(const std::string &page_name) {
+	this->erase(page_name + "i");
+	this->erase(page_name + "p");
+}
+
+void IndexCache::clear() {
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_blocks.clear();
+	m_postings.clear();
+}
+
+size_t IndexCache::size() const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_blocks.size();
+}
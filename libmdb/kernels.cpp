@@ -0,0 +1,238 @@
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MDB_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace mdb;
+
+namespace {
+typedef size_t (*filter_past_time_fn)(const Meas *, size_t, Time, Time, Meas *);
+typedef size_t (*scan_fn)(const Meas *, uint32_t, const kernels::ScanFilter &, uint32_t *);
+
+/// ids filter of scan, nullptr if any id passed.
+const IdFilter *scanIds(const kernels::ScanFilter &filter) {
+  return (filter.ids != nullptr && !filter.ids->empty()) ? filter.ids : nullptr;
+}
+
+/// scalar scan of [begin, count), positions writed to sel from sel[result].
+size_t scanRange(const Meas *src, uint32_t begin, uint32_t count, const kernels::ScanFilter &filter,
+                 uint32_t *sel, size_t result) {
+  auto ids = scanIds(filter);
+  for (uint32_t i = begin; i < count; ++i) {
+    const Meas &m = src[i];
+    bool pass = (!filter.checkTime || ((filter.from <= m.time) && (m.time <= filter.to))) &&
+                ((filter.source == 0) || (m.source == filter.source)) &&
+                ((filter.flag == 0) || (m.flag == filter.flag)) &&
+                ((ids == nullptr) || ids->contains(m.id));
+    sel[result] = i;
+    result += pass ? 1 : 0;
+  }
+  return result;
+}
+
+/// add to sel values of block, which bits are set in mask and ids of which pass filter.
+inline size_t selectBlock(const Meas *src, uint32_t begin, unsigned mask, unsigned width,
+                          const IdFilter *ids, uint32_t *sel, size_t result) {
+  if (ids == nullptr) {
+    for (unsigned j = 0; j < width; ++j) {
+      sel[result] = begin + j;
+      result += (mask >> j) & 1;
+    }
+  } else if (mask != 0) {
+    for (unsigned j = 0; j < width; ++j) {
+      sel[result] = begin + j;
+      result += (((mask >> j) & 1) && ids->contains(src[begin + j].id)) ? 1 : 0;
+    }
+  }
+  return result;
+}
+
+#ifdef MDB_KERNELS_AVX2
+/// check time of 4 values by one gather, copy is branchless:
+/// each value writed to dst, but dst position moved only for passed.
+__attribute__((target("avx2")))
+size_t filterPastTimeAVX2(const Meas *src, size_t count, Time cur_time, Time past_time, Meas *dst) {
+  const long long stride = sizeof(Meas) / sizeof(long long);
+  const __m256i offsets = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+  const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+  const __m256i cur = _mm256_set1_epi64x(static_cast<long long>(cur_time));
+  // unsigned (cur - t) <= past  <=>  !(signed (cur - t)^sign > past^sign)
+  const __m256i past = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(past_time)), sign);
+
+  size_t result = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    auto base = reinterpret_cast<const long long *>(&src[i].time);
+    __m256i times = _mm256_i64gather_epi64(base, offsets, 8);
+    __m256i delta = _mm256_xor_si256(_mm256_sub_epi64(cur, times), sign);
+    __m256i too_old = _mm256_cmpgt_epi64(delta, past);
+    int mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(too_old)) & 0xF;
+    if (mask == 0xF) {
+      dst[result] = src[i];
+      dst[result + 1] = src[i + 1];
+      dst[result + 2] = src[i + 2];
+      dst[result + 3] = src[i + 3];
+      result += 4;
+      continue;
+    }
+    for (int j = 0; j < 4; ++j) {
+      dst[result] = src[i + j];
+      result += (mask >> j) & 1;
+    }
+  }
+  return result + kernels::filterPastTimeScalar(src + i, count - i, cur_time, past_time, dst + result);
+}
+#endif
+}
+
+#ifdef MDB_KERNELS_AVX2
+/// time, source and flag of 4 values checked by gathers and compares,
+/// ids checked only for values passed other predicates.
+__attribute__((target("avx2")))
+size_t kernels::scanAVX2(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  const long long stride = sizeof(Meas) / sizeof(long long);
+  const __m256i offsets = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+  const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+  // unsigned compare as signed compare of values with inverted high bit.
+  const __m256i from = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(filter.from)), sign);
+  const __m256i to = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(filter.to)), sign);
+  const __m256i source = _mm256_set1_epi64x(static_cast<long long>(filter.source));
+  const __m256i flag = _mm256_set1_epi64x(static_cast<long long>(filter.flag));
+  auto ids = scanIds(filter);
+
+  size_t result = 0;
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i rejected = _mm256_setzero_si256();
+    if (filter.checkTime) {
+      auto base = reinterpret_cast<const long long *>(&src[i].time);
+      __m256i times = _mm256_xor_si256(_mm256_i64gather_epi64(base, offsets, 8), sign);
+      rejected = _mm256_or_si256(_mm256_cmpgt_epi64(from, times), _mm256_cmpgt_epi64(times, to));
+    }
+    if (filter.source != 0) {
+      auto base = reinterpret_cast<const long long *>(&src[i].source);
+      __m256i sources = _mm256_i64gather_epi64(base, offsets, 8);
+      rejected = _mm256_or_si256(rejected, _mm256_xor_si256(_mm256_cmpeq_epi64(sources, source),
+                                                            _mm256_set1_epi64x(-1)));
+    }
+    if (filter.flag != 0) {
+      auto base = reinterpret_cast<const long long *>(&src[i].flag);
+      __m256i flags = _mm256_i64gather_epi64(base, offsets, 8);
+      rejected = _mm256_or_si256(rejected, _mm256_xor_si256(_mm256_cmpeq_epi64(flags, flag),
+                                                            _mm256_set1_epi64x(-1)));
+    }
+    unsigned mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(rejected)) & 0xF;
+    result = selectBlock(src, i, mask, 4, ids, sel, result);
+  }
+  return scanRange(src, i, count, filter, sel, result);
+}
+
+/// same as scanAVX2 for 8 values, compares produce mask directly.
+__attribute__((target("avx512f")))
+size_t kernels::scanAVX512(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  const long long stride = sizeof(Meas) / sizeof(long long);
+  const __m512i offsets = _mm512_setr_epi64(0, stride, 2 * stride, 3 * stride,
+                                            4 * stride, 5 * stride, 6 * stride, 7 * stride);
+  const __m512i from = _mm512_set1_epi64(static_cast<long long>(filter.from));
+  const __m512i to = _mm512_set1_epi64(static_cast<long long>(filter.to));
+  const __m512i source = _mm512_set1_epi64(static_cast<long long>(filter.source));
+  const __m512i flag = _mm512_set1_epi64(static_cast<long long>(filter.flag));
+  auto ids = scanIds(filter);
+
+  size_t result = 0;
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __mmask8 mask = 0xFF;
+    if (filter.checkTime) {
+      __m512i times = _mm512_i64gather_epi64(offsets, &src[i].time, 8);
+      mask = _mm512_mask_cmpge_epu64_mask(mask, times, from);
+      mask = _mm512_mask_cmple_epu64_mask(mask, times, to);
+    }
+    if (filter.source != 0) {
+      __m512i sources = _mm512_i64gather_epi64(offsets, &src[i].source, 8);
+      mask = _mm512_mask_cmpeq_epu64_mask(mask, sources, source);
+    }
+    if (filter.flag != 0) {
+      __m512i flags = _mm512_i64gather_epi64(offsets, &src[i].flag, 8);
+      mask = _mm512_mask_cmpeq_epu64_mask(mask, flags, flag);
+    }
+    result = selectBlock(src, i, mask, 8, ids, sel, result);
+  }
+  return scanRange(src, i, count, filter, sel, result);
+}
+#else
+size_t kernels::scanAVX2(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  return scanScalar(src, count, filter, sel);
+}
+
+size_t kernels::scanAVX512(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  return scanScalar(src, count, filter, sel);
+}
+#endif
+
+namespace {
+filter_past_time_fn selectFilterPastTime() {
+#ifdef MDB_KERNELS_AVX2
+  if (kernels::haveAVX2()) {
+    return &filterPastTimeAVX2;
+  }
+#endif
+  return &kernels::filterPastTimeScalar;
+}
+
+scan_fn selectScan() {
+#ifdef MDB_KERNELS_AVX2
+  if (kernels::haveAVX512()) {
+    return &kernels::scanAVX512;
+  }
+  if (kernels::haveAVX2()) {
+    return &kernels::scanAVX2;
+  }
+#endif
+  return &kernels::scanScalar;
+}
+
+const filter_past_time_fn filter_past_time = selectFilterPastTime();
+const scan_fn scan_values = selectScan();
+}
+
+bool kernels::haveAVX2() {
+#ifdef MDB_KERNELS_AVX2
+  static const bool result = __builtin_cpu_supports("avx2");
+  return result;
+#else
+  return false;
+#endif
+}
+
+bool kernels::haveAVX512() {
+#ifdef MDB_KERNELS_AVX2
+  static const bool result = __builtin_cpu_supports("avx512f");
+  return result;
+#else
+  return false;
+#endif
+}
+
+size_t kernels::filterPastTimeScalar(const Meas *src, size_t count, Time cur_time, Time past_time, Meas *dst) {
+  size_t result = 0;
+  for (size_t i = 0; i < count; ++i) {
+    dst[result] = src[i];
+    result += (cur_time - src[i].time) <= past_time ? 1 : 0;
+  }
+  return result;
+}
+
+size_t kernels::filterPastTime(const Meas *src, size_t count, Time cur_time, Time past_time, Meas *dst) {
+  return filter_past_time(src, count, cur_time, past_time, dst);
+}
+
+size_t kernels::scanScalar(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  return scanRange(src, 0, count, filter, sel, 0);
+}
+
+size_t kernels::scan(const Meas *src, uint32_t count, const ScanFilter &filter, uint32_t *sel) {
+  return scan_values(src, count, filter, sel);
+}
@@ -21,9 +21,6 @@ bool mdb::checkPastTime(const Time t, const Time past_time) { // |current time -
   if (past_time == 0) {
     return true;
   } else {
-    Time cur_t = mdb::TimeWork::CurrentUtcTime();
-    auto delta = cur_t - t;
-
-    return delta <= past_time;
+    return checkPastTime(t, past_time, mdb::TimeWork::CurrentUtcTime());
   }
 }
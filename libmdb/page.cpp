@@ -13,8 +13,17 @@
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 uint64_t mdb::PageReader::ReadSize=mdb::PageReader::defaultReadSize;
+
+mdb::MapOptions::MapOptions() : populate(false), hugePages(false), sequential(false), dontNeed(false) {}
 namespace bi=boost::interprocess;
+namespace fs=boost::filesystem;
 
 using namespace mdb;
 
@@ -36,10 +45,27 @@ bool mdb::HeaderIdIntervalCheck(Id from, Id to, Page::Header hdr) {
 	}
 }
 
+bool mdb::HeaderLaneCheck(const IdArray &ids, Page::Header hdr) {
+	if (ids.size() == 0 || hdr.lanes <= 1) {
+		return true;
+	}
+	for (auto id : ids) {
+		if (Page::laneOf(id, hdr.lanes) == hdr.lane) {
+			return true;
+		}
+	}
+	return false;
+}
+
 Page::Page(std::string fname)
     : m_filename(new std::string(fname)),
       m_file(nullptr),
-      m_region(nullptr)
+      m_region(nullptr),
+      m_readonly(false),
+      m_build_postings(false),
+      m_ww_file(nullptr),
+      m_ww_region(nullptr),
+      m_ww_capacity(0)
 {
 	
 	this->m_index.setFileName(this->index_fileName());
@@ -53,56 +79,148 @@ Page::~Page() {
 void Page::close() {
     if ((this->m_file!=nullptr) && (m_region!=nullptr)) {
         //logger("write_window.size="<<m_writewindow.size());
-        this->flushWriteWindow();
+        this->flush();
+        // writer seals full page.
+        auto seal = !m_readonly && this->isFull();
+        if (m_build_postings && seal) {
+            this->buildPostings();
+        }
         this->m_header->isOpen = false;
         this->m_header->ReadersCount = 0;
+        auto drop = m_map_options.dontNeed && seal;
+        if (drop) {
+            this->dropCache();
+        }
         delete m_region;
         delete m_file;
         m_region=nullptr;
         m_file=nullptr;
+        this->unmapWriteWindow();
+    }
+}
 
+void Page::flush() {
+    this->m_index.flush();
+    this->flushWriteWindow();
+}
+
+void Page::sync() {
+    this->flush();
+    auto used_bytes = sizeof(Page::Header) + sizeof(Meas) * m_header->write_pos;
+    m_region->flush(0, used_bytes, false);
+    this->m_index.sync();
+    if (m_header->WriteWindowSize != 0) {
+        utils::sync_file(this->writewindow_fileName());
     }
 }
 
 void Page::flushWriteWindow(){
-    this->m_header->WriteWindowSize=m_writewindow.size();
-    if(this->m_header->WriteWindowSize!=0){
-        std::ofstream ofs;
-        ofs.open(this->writewindow_fileName(),std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
-        assert(ofs.is_open());
-
-        for(auto kv:m_writewindow){
-            ofs.write((char*)&kv,sizeof(Meas));
-        }
+    if (m_ww_dirty.empty()) {
+        return;
+    }
+    this->mapWriteWindow(m_ww_slot_ids.size());
 
-        ofs.close();
+    auto data = static_cast<Meas*>(m_ww_region->get_address());
+    for (auto slot : m_ww_dirty) {
+        data[slot] = m_writewindow.get(m_ww_slot_ids[slot]);
+        m_ww_dirty_flag[slot] = false;
     }
+    m_ww_dirty.clear();
+    this->m_header->WriteWindowSize = m_ww_slot_ids.size();
 }
 
-void Page::loadWriteWindow(){
-
-	std::ifstream ifs(this->writewindow_fileName(), std::ifstream::binary | std::ifstream::in);
-    if(!ifs.is_open()){
-		/// this is not error. write window file is no exists, when openned empty page without data.
+void Page::mapWriteWindow(uint64_t size) {
+    if ((m_ww_region != nullptr) && (size <= m_ww_capacity)) {
         return;
     }
+    this->unmapWriteWindow();
+    auto fname = this->writewindow_fileName();
+    if (!fs::exists(fname)) {
+        std::ofstream ofs(fname, std::ofstream::binary | std::ofstream::out);
+    }
+    // grow file by doubling, mapping is recreated only on grow.
+    auto file_entries = fs::file_size(fname) / sizeof(Meas);
+    m_ww_capacity = std::max(file_entries, uint64_t(ww_min_capacity));
+    while (m_ww_capacity < size) {
+        m_ww_capacity *= 2;
+    }
+    if (file_entries < m_ww_capacity) {
+        fs::resize_file(fname, m_ww_capacity * sizeof(Meas));
+    }
+    try {
+        m_ww_file = new bi::file_mapping(fname.c_str(), bi::read_write);
+        m_ww_region = new bi::mapped_region(*m_ww_file, bi::read_write);
+    } catch (std::runtime_error &ex) {
+        throw MAKE_EXCEPTION(ex.what());
+    }
+}
 
-    while(true){
-        Meas value;
-        if(!ifs.read((char*)&value,sizeof(value))){
-			this->updateWriteWindow(value);
-            break;
-        }else{
-			this->updateWriteWindow(value);
-        }
+void Page::unmapWriteWindow() {
+    delete m_ww_region;
+    delete m_ww_file;
+    m_ww_region = nullptr;
+    m_ww_file = nullptr;
+    m_ww_capacity = 0;
+}
+
+void Page::markWriteWindow(Id id) {
+    auto it = m_ww_slots.find(id);
+    uint64_t slot = 0;
+    if (it == m_ww_slots.end()) {
+        slot = m_ww_slot_ids.size();
+        m_ww_slots.insert(std::make_pair(id, slot));
+        m_ww_slot_ids.push_back(id);
+    } else {
+        slot = it->second;
+    }
+    if (m_ww_dirty_flag.size() <= slot) {
+        m_ww_dirty_flag.resize(slot + 1, false);
+    }
+    if (!m_ww_dirty_flag[slot]) {
+        m_ww_dirty_flag[slot] = true;
+        m_ww_dirty.push_back(slot);
     }
+}
 
+void Page::loadWriteWindow(){
+    auto fname = this->writewindow_fileName();
+    if (!fs::exists(fname)) {
+		/// this is not error. write window file is no exists, when openned empty page without data.
+        return;
+    }
+    // file may be bigger, than window (see mapWriteWindow)
+    auto count = std::min(uint64_t(m_header->WriteWindowSize), uint64_t(fs::file_size(fname) / sizeof(Meas)));
+	std::ifstream ifs(fname, std::ifstream::binary | std::ifstream::in);
+    std::vector<Meas> values(count);
+    ifs.read((char*)values.data(), count * sizeof(Meas));
+    // slot of value is position in file, id is stored in value.
+    for (uint64_t slot = 0; slot < count; ++slot) {
+        m_writewindow.update(values[slot]);
+        m_ww_slots.insert(std::make_pair(values[slot].id, slot));
+        m_ww_slot_ids.push_back(values[slot].id);
+    }
 }
 
 size_t Page::size() const { return m_region->get_size(); }
 
 std::string Page::fileName() const { return std::string(*m_filename); }
 
+void Page::rename(const std::string &filename) {
+    fs::rename(this->fileName(), filename);
+    fs::rename(this->index_fileName(), filename + "i");
+    IndexCache::get()->erasePage(filename);
+    if (fs::exists(this->writewindow_fileName())) {
+        fs::rename(this->writewindow_fileName(), filename + "w");
+    }
+    *m_filename = filename;
+    this->m_index.setFileName(this->index_fileName());
+}
+
+void Page::setLane(uint32_t lane, uint32_t lanes) {
+    m_header->lane = lane;
+    m_header->lanes = lanes;
+}
+
 std::string Page::index_fileName() const {
   return std::string(*m_filename) + "i";
 }
@@ -111,6 +229,14 @@ std::string Page::writewindow_fileName() const {
 	return std::string(*m_filename) + "w";
 }
 
+std::string Page::postings_fileName() const {
+	return std::string(*m_filename) + "p";
+}
+
+void Page::buildPostings() {
+    Postings::Build(this->postings_fileName(), m_data_begin, m_header->write_pos);
+}
+
 Time Page::minTime() const { 
 	return m_header->minTime; 
 }
@@ -119,7 +245,7 @@ Time Page::maxTime() const {
 	return m_header->maxTime; 
 }
 
-Page::Page_ptr Page::Open(std::string filename, bool readOnly) {
+Page::Page_ptr Page::Open(std::string filename, bool readOnly, const MapOptions &options) {
     if(!readOnly){
         mdb::Page::Header hdr = Page::ReadHeader(filename);
         if (hdr.isOpen) {
@@ -129,32 +255,44 @@ Page::Page_ptr Page::Open(std::string filename, bool readOnly) {
         }
     }
     Page_ptr result(new Page(filename));
+    result->m_map_options = options;
 
-    try {
-           result->m_file=new bi::file_mapping(filename.c_str(),bi::read_write);
-           result->m_region=new bi::mapped_region(*result->m_file, bi::read_write);
-    } catch (std::runtime_error &ex) {
-        std::string what = ex.what();
-        throw MAKE_EXCEPTION(ex.what());
-    }
+    result->map(readOnly);
 
     char *data = static_cast<char*>(result->m_region->get_address());
     result->m_header = (Page::Header *)data;
     result->m_data_begin = (Meas *)(data + sizeof(Page::Header));
+    if (result->m_header->version != page_version) {
+        auto hdr = *result->m_header;
+        // page of other format must not be changed by close.
+        delete result->m_region;
+        delete result->m_file;
+        result->m_region = nullptr;
+        result->m_file = nullptr;
+        CheckVersion(hdr, filename);
+    }
 
     result->m_header->isOpen = true;
     if(readOnly){
         result->m_header->ReadersCount+=1;
+        // full page is sealed, its index not changed after writer flushed it.
+        if (result->isFull()) {
+            result->m_index.useShared(result->m_header->write_pos);
+        }
     }
-	result->m_region->flush(0, sizeof(result->m_header), false);
 
     result->loadWriteWindow();
 
     return result;
 }
 
-Page::Page_ptr Page::Create(std::string filename, uint64_t fsize) {
+Page::Page_ptr Page::Create(std::string filename, uint64_t fsize, uint32_t lane, uint32_t lanes,
+                            const MapOptions &options) {
   Page_ptr result(new Page(filename));
+  result->m_map_options = options;
+  IndexCache::get()->erasePage(filename);
+  fs::remove(result->postings_fileName());
+  fs::remove(result->postings_fileName() + ".tmp");
 
   try {
       {
@@ -166,22 +304,66 @@ Page::Page_ptr Page::Create(std::string filename, uint64_t fsize) {
           fbuf.pubseekoff(fsize-1, std::ios_base::beg);
           fbuf.sputc(0);
       }
-      result->m_file=new bi::file_mapping(filename.c_str(),bi::read_write);
-      result->m_region=new bi::mapped_region(*result->m_file, bi::read_write);
+      utils::preallocate_file(filename, fsize);
   } catch (std::runtime_error &ex) {
 	  std::string what = ex.what();
 	  throw MAKE_EXCEPTION(ex.what());
   }
+  result->map(false);
 
   char *data = static_cast<char*>(result->m_region->get_address());
 
   result->initHeader(data);
+  result->m_header->lane = lane;
+  result->m_header->lanes = lanes;
+  result->m_index.reset();
   result->m_data_begin = (Meas *)(data + sizeof(Page::Header));
   result->m_header->isOpen = true;
-  result->m_region->flush(0, sizeof(result->m_header), false);
   return result;
 }
 
+void Page::map(bool readOnly) {
+    m_readonly = readOnly;
+    auto options = bi::default_map_options;
+#if defined(MAP_POPULATE)
+    if (m_map_options.populate && !readOnly) {
+        options = MAP_POPULATE;
+    }
+#endif
+    try {
+        m_file = new bi::file_mapping(m_filename->c_str(), bi::read_write);
+        m_region = new bi::mapped_region(*m_file, bi::read_write, 0, 0, nullptr, options);
+    } catch (std::runtime_error &ex) {
+        throw MAKE_EXCEPTION(ex.what());
+    }
+    if (readOnly) {
+        if (m_map_options.sequential) {
+            m_region->advise(bi::mapped_region::advice_sequential);
+        }
+    } else {
+#if defined(MADV_HUGEPAGE)
+        if (m_map_options.hugePages) {
+            ::madvise(m_region->get_address(), m_region->get_size(), MADV_HUGEPAGE);
+        }
+#endif
+    }
+}
+
+void Page::dropCache() {
+    // dirty pages must be on disk, else they not dropped.
+    if (!m_readonly) {
+        m_region->flush(0, 0, false);
+    }
+    m_region->advise(bi::mapped_region::advice_dontneed);
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    int fd = ::open(m_filename->c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#endif
+}
+
 Page::Header Page::ReadHeader(std::string filename) {
   std::ifstream istream;
   istream.open(filename, std::fstream::in);
@@ -193,15 +375,32 @@ Page::Header Page::ReadHeader(std::string filename) {
   Header result;
   istream.read((char *)&result, sizeof(Page::Header));
   istream.close();
+  CheckVersion(result, filename);
   return result;
 }
 
+void Page::CheckVersion(const Header &hdr, const std::string &filename) {
+  if (hdr.version != page_version) {
+    std::stringstream ss;
+    ss << "unknown page version " << int(hdr.version) << " (expected " << int(page_version)
+       << "). filename=" << filename;
+    throw MAKE_EXCEPTION(ss.str());
+  }
+}
+
 void Page::initHeader(char *data) {
   m_header = (Page::Header *)data;
   memset(m_header, 0, sizeof(Page::Header));
   m_header->version = page_version;
   m_header->size = this->size();
   m_header->minMaxInit = false;
+  m_header->timeSorted = true;
+}
+
+void Page::updateTimeSorted(const Meas& value) {
+  if (m_header->minMaxInit && (value.time < m_header->maxTime)) {
+    m_header->timeSorted = false;
+  }
 }
 
 void Page::updateMinMax(const Meas& value) {
@@ -223,14 +422,9 @@ void Page::updateMinMax(const Meas& value) {
 }
 
 void Page::updateWriteWindow(const Meas&m) {
-	if (m_writewindow.size() <= m.id) {
-		m_writewindow.resize(m.id+1);
-		m_writewindow[m.id] = m;
-	} else {
-		auto old_value = m_writewindow[m.id];
-		if (old_value.time<m.time) {
-			m_writewindow[m.id] = m;
-		}
+	if (m_writewindow.update(m)) {
+		this->markWriteWindow(m.id);
+		m_ww_snapshot = nullptr;
 	}
 }
 
@@ -240,23 +434,15 @@ bool Page::append(const Meas& value) {
         return false;
     }
 
+    updateTimeSorted(value);
     updateMinMax(value);
 
 	updateWriteWindow(value);
-    m_header->WriteWindowSize=m_writewindow.size();
 
 
     memcpy(&m_data_begin[m_header->write_pos], &value, sizeof(Meas));
 
-    Index::IndexRecord rec;
-    rec.minTime = value.time;
-    rec.maxTime = value.time;
-    rec.minId = value.id;
-    rec.maxId = value.id;
-    rec.count = 1;
-    rec.pos = m_header->write_pos;
-
-    this->m_index.writeIndexRec(rec);
+    this->m_index.append(value, m_header->write_pos);
 
     m_header->write_pos++;
     return true;
@@ -280,23 +466,12 @@ size_t Page::append(const Meas::PMeas begin, const size_t size) {
 
     for(auto it=begin;it!=begin+to_write;it++){
 		updateWriteWindow(*it);
+		updateTimeSorted(*it);
+		updateMinMax(*it);
     }
-    m_header->WriteWindowSize=m_writewindow.size();
-
-    updateMinMax(begin[0]);
-    updateMinMax(begin[to_write-1]);
-	//m_region->flush(0, this->size(), false);
 
-    Index::IndexRecord rec;
-    rec.minTime = begin[0].time;
-    rec.maxTime = begin[to_write - 1].time;
-    rec.minId = begin[0].id;
-    rec.maxId = begin[to_write - 1].id;
-    rec.count = to_write;
-    rec.pos = m_header->write_pos;
+    this->m_index.append(begin, to_write, m_header->write_pos);
 
-    this->m_index.writeIndexRec(rec);
-	
     m_header->write_pos += to_write;
     return to_write;
 }
@@ -320,6 +495,13 @@ bool Page::read(Meas::PMeas result, uint64_t position) {
     return true;
 }
 
+const Meas *Page::values(uint64_t begin, uint64_t end) const {
+    if ((begin > end) || (end > m_header->write_pos)) {
+        return nullptr;
+    }
+    return &m_data_begin[begin];
+}
+
 void Page::readComplete(){
     std::lock_guard<std::mutex> _lock(m_lock);
 
@@ -333,12 +515,20 @@ void Page::readComplete(){
     }
 }
 
-WriteWindow Page::getWriteWindow(){
-    return WriteWindow(m_writewindow.begin(),m_writewindow.end());
+WriteWindow_ptr Page::getWriteWindow(){
+    // snapshot is shared, until next change of window.
+    if (m_ww_snapshot == nullptr) {
+        m_ww_snapshot = std::make_shared<const WriteWindow>(m_writewindow);
+    }
+    return m_ww_snapshot;
 }
 
 void Page::setWriteWindow(const WriteWindow&other){
-    m_writewindow=WriteWindow{other.begin(),other.end()};
+    m_writewindow = other;
+    m_ww_snapshot = nullptr;
+    for (const auto &m : m_writewindow) {
+        this->markWriteWindow(m.id);
+    }
 }
 
 PageReader_ptr  Page::readAll() {
@@ -354,7 +544,8 @@ PageReader_ptr  Page::readAll() {
 }
 
 
-PageReader_ptr Page::readFromToPos(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to,size_t begin,size_t end){
+PageReader_ptr Page::readFromToPos(const IdArray &ids, const IdFilter_ptr &id_filter, mdb::Flag source, mdb::Flag flag,
+                                   Time from, Time to, size_t begin, size_t end, bool in_time_range){
     if(this->m_header->write_pos==0){
         return nullptr;
     }
@@ -363,11 +554,12 @@ PageReader_ptr Page::readFromToPos(const IdArray &ids, mdb::Flag source, mdb::Fl
     auto preader=new PageReaderInterval(ppage);
     auto result=PageReader_ptr(preader);
     preader->addReadPos(begin,end);
-    preader->ids=ids;
+    preader->setIds(ids, id_filter);
     preader->source=source;
     preader->flag=flag;
     preader->from=from;
     preader->to=to;
+    preader->inTimeRange=in_time_range;
     return result;
 }
 
@@ -379,17 +571,19 @@ PageReader_ptr Page::readInterval(Time from, Time to) {
     return this->readInterval(emptyArray, 0, 0, from, to);
 }
 
-PageReader_ptr Page::readInterval(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to) {
+PageReader_ptr Page::readInterval(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time from, Time to,
+                                  const IdFilter_ptr &id_filter) {
     // [from...minTime,maxTime...to]
     if(this->m_header->write_pos==0){
         return nullptr;
     }
+    auto filter = (id_filter != nullptr) ? id_filter : IdFilter::make(ids);
 	if (from > this->m_header->maxTime) {
 		/// read from write window
 		auto ppage = this->shared_from_this();
         auto preader = new PageReaderInterval(ppage);
 		auto result = PageReader_ptr(preader);
-        preader->ids = ids;
+        preader->setIds(ids, filter);
         preader->source = source;
         preader->flag = flag;
         preader->from = from;
@@ -397,6 +591,12 @@ PageReader_ptr Page::readInterval(const IdArray &ids, mdb::Flag source, mdb::Fla
         preader->isWindowReader = true;
 		return result;
 	}
+    if ((ids.size() != 0) && m_readonly && this->isFull()) {
+        auto postings = IndexCache::get()->postings(this->postings_fileName());
+        if (postings != nullptr) {
+            return this->readPositions(ids, filter, source, flag, from, to, postings->positions(ids));
+        }
+    }
     if ((from <= m_header->minTime) && (to >= m_header->maxTime)) {
         if ((ids.size() == 0) && (source == 0) && (flag == 0)) {
             auto result=this->readAll();
@@ -405,14 +605,26 @@ PageReader_ptr Page::readInterval(const IdArray &ids, mdb::Flag source, mdb::Fla
             preader->to=to;
             return result;
         } else {
-            return this->readFromToPos(ids, source, flag, from, to, 0, m_header->write_pos);
+            return this->readFromToPos(ids, filter, source, flag, from, to, 0, m_header->write_pos, false);
         }
     }
-	m_region->flush(0, this->size(), false);
+
+    // write_pos readed before flag: writer clear flag before append of unsorted value.
+    auto count = m_header->write_pos;
+    if (m_header->timeSorted) {
+        // exact positions of interval: O(log n) + size of result.
+        auto begin = std::lower_bound(m_data_begin, m_data_begin + count, from,
+                                      [](const Meas &m, Time t) { return m.time < t; });
+        auto end = std::upper_bound(begin, m_data_begin + count, to,
+                                    [](Time t, const Meas &m) { return t < m.time; });
+        return this->readFromToPos(ids, filter, source, flag, from, to,
+                                   begin - m_data_begin, end - m_data_begin, true);
+    }
+
     auto ppage=this->shared_from_this();
     auto preader=new PageReaderInterval(ppage);
     auto result=PageReader_ptr(preader);
-    preader->ids = ids;
+    preader->setIds(ids, filter);
     preader->source = source;
     preader->flag = flag;
     preader->from = from;
@@ -426,26 +638,50 @@ PageReader_ptr Page::readInterval(const IdArray &ids, mdb::Flag source, mdb::Fla
   return result;
 }
 
+PageReader_ptr Page::readPositions(const IdArray &ids, const IdFilter_ptr &id_filter, mdb::Flag source, mdb::Flag flag,
+                                   Time from, Time to, const std::vector<uint64_t> &positions) {
+    auto ppage = this->shared_from_this();
+    auto preader = new PageReaderInterval(ppage);
+    auto result = PageReader_ptr(preader);
+    preader->setIds(ids, id_filter);
+    preader->source = source;
+    preader->flag = flag;
+    preader->from = from;
+    preader->to = to;
+    // neighboring positions readed as one range.
+    size_t i = 0;
+    while (i < positions.size()) {
+        size_t run_end = i + 1;
+        while ((run_end < positions.size()) && (positions[run_end] == positions[run_end - 1] + 1)) {
+            run_end++;
+        }
+        preader->addReadPos(positions[i], positions[run_end - 1] + 1);
+        i = run_end;
+    }
+    return result;
+}
+
 PageReader_ptr Page::readInTimePoint(Time time_point) {
 	static IdArray emptyArray;
 	return this->readInTimePoint(emptyArray, 0, 0, time_point);
 }
 
-PageReader_ptr Page::readInTimePoint(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point) {
+PageReader_ptr Page::readInTimePoint(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point,
+                                     const IdFilter_ptr &id_filter) {
 	if (this->m_header->write_pos == 0) {
 		return nullptr;
 	}
 	auto ppage = this->shared_from_this();
     auto preader = new PageReader_TimePoint(ppage);
 	auto result = PageReader_ptr(preader);
-    preader->ids = ids;
+    preader->setIds(ids, id_filter);
     preader->source = source;
     preader->flag = flag;
     preader->time_point = time_point;
 	return result;
 }
 
-Meas::MeasList Page::backwardRead(const IdArray &ids, mdb::Flag source, mdb::Flag flag, Time time_point) {
+Meas::MeasList Page::backwardRead(const IdFilter &ids, mdb::Flag source, mdb::Flag flag, Time time_point) {
 	Meas::MeasList result;
 	
 	std::map<Id, Meas> readed_values{};
@@ -472,12 +708,7 @@ Meas::MeasList Page::backwardRead(const IdArray &ids, mdb::Flag source, mdb::Fla
 						source_check = false;
 					}
 				}
-				bool ids_check = true;
-				if (ids.size() != 0) {
-					if (std::find(ids.cbegin(), ids.cend(), m.id) != ids.end()) {
-						ids_check = false;
-					}
-				}
+				bool ids_check = ids.contains(m.id);
 				if (flag_check && source_check && ids_check) {
 					readed_values.insert(std::make_pair(m.id, m));
 				}
@@ -508,11 +739,23 @@ size_t Page::capacity() const {
 
 Page::Header Page::getHeader() const { return *m_header; }
 
+MeasSpan::MeasSpan() : values(nullptr), count(0), filtered(false) {}
+
+void MeasSpan::clear() {
+    values = nullptr;
+    count = 0;
+    filtered = false;
+    selection.clear();
+    buffer.clear();
+    pin = nullptr;
+}
+
 PageReader::PageReader(Page::Page_ptr page):
     ids(),
+    id_filter(IdFilter::all()),
     source(0),
     flag(0),
-    prev_ww()
+    prev_ww(std::make_shared<const WriteWindow>())
 {
     m_page=page;
 }
@@ -535,12 +778,12 @@ bool PageReader::checkValueFlags(const Meas&m)const {
             return false;
         }
     }
-    if (ids.size() != 0) {
-        if (std::find(ids.cbegin(), ids.cend(), m.id) == ids.end()) {
-            return false;
-        }
-    }
-    return true;
+    return id_filter->contains(m.id);
+}
+
+void PageReader::setIds(const IdArray &ids, const IdFilter_ptr &filter) {
+    this->ids = ids;
+    this->id_filter = (filter != nullptr) ? filter : IdFilter::make(ids);
 }
 
 void PageReader::readAll(Meas::MeasList*output) {
@@ -549,9 +792,23 @@ void PageReader::readAll(Meas::MeasList*output) {
     }
 }
 
+bool PageReader::readNextSpan(MeasSpan*span) {
+    span->clear();
+    if (isEnd()) {
+        return false;
+    }
+    Meas::MeasList readed;
+    this->readNext(&readed);
+    span->buffer.assign(readed.begin(), readed.end());
+    span->values = span->buffer.data();
+    span->count = span->buffer.size();
+    span->pin = shared_from_this();
+    return true;
+}
+
 void PageReader::timePointRead(Time tp,Meas::MeasList*output) {
     if (tp > this->m_page->getHeader().maxTime) {
-        for (auto wwIt : this->m_page->getWriteWindow()) {
+        for (auto wwIt : *this->m_page->getWriteWindow()) {
             if (wwIt.time == 0) {
                 continue;
             }
@@ -561,10 +818,10 @@ void PageReader::timePointRead(Time tp,Meas::MeasList*output) {
             }
         }
     } else {
-        auto sub_result = this->m_page->backwardRead(this->ids, source, flag, tp);
+        auto sub_result = this->m_page->backwardRead(*this->id_filter, source, flag, tp);
 
         // to ouput pushing values from prev_ww, that no exists in sub_result
-        for (auto wwIt : prev_ww) {
+        for (auto wwIt : *prev_ww) {
             if (wwIt.time == 0) {
                 continue;
             }
@@ -2,7 +2,9 @@
 #include "common.h"
 
 #include "exception.h"
+#include "logger.h"
 
+#include <map>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -10,12 +12,32 @@ using namespace mdb;
 
 PageManager *PageManager::m_instance=nullptr;
 
+const std::string spare_page_ext = ".spare";
+
+PageManager::PageManager() : m_spare_pages(false), m_build_postings(false) {
+}
+
+PageManager::~PageManager() {
+	std::lock_guard<std::mutex> lock(m_lock);
+	this->dropSpares();
+}
+
 void PageManager::start(std::string path) {
 	if (m_instance != nullptr) {
 		throw MAKE_EXCEPTION("m_instance != nullptr");
 	}
 	PageManager::m_instance = new PageManager();
 	m_instance->m_path = path;
+	m_instance->m_curpages.resize(1);
+	m_instance->m_spares.resize(1);
+	// spares of crashed process.
+	if (fs::exists(path)) {
+		for (auto ext : { spare_page_ext, spare_page_ext + "i", spare_page_ext + "w" }) {
+			for (auto p : utils::ls(path, ext)) {
+				fs::remove(p);
+			}
+		}
+	}
 }
 
 void PageManager::stop() {
@@ -27,39 +49,225 @@ PageManager* PageManager::get() {
 	return m_instance;
 }
 
-Page::Page_ptr PageManager::getCurPage() {
-	return m_curpage;
+void PageManager::setLanes(size_t lanes) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (lanes == m_curpages.size()) {
+		return;
+	}
+	// ids move between lanes, so each new page get last values of all ids.
+	WriteWindow wwindow;
+	bool loaded = false;
+	for (auto &page : m_curpages) {
+		if (page == nullptr) {
+			continue;
+		}
+		loaded = true;
+		for (const auto &m : *page->getWriteWindow()) {
+			wwindow.update(m);
+		}
+		auto empty = page->getHeader().write_pos == 0;
+		auto fname = page->fileName();
+		page->close();
+		page = nullptr;
+		if (empty) {
+			this->removePage(fname);
+		}
+	}
+	m_curpages.clear();
+	m_curpages.resize(lanes);
+	if (loaded) {
+		for (size_t i = 0; i < lanes; ++i) {
+			this->createPage(i, &wwindow);
+		}
+	}
+}
+
+size_t PageManager::lanes()const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_curpages.size();
+}
+
+Page::Page_ptr PageManager::getCurPage(size_t lane) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (lane >= m_curpages.size()) {
+		return nullptr;
+	}
+	return m_curpages[lane];
 }
 
 void PageManager::closeCurrentPage() {
-	if (m_curpage != nullptr) {
-		m_curpage->close();
-		m_curpage = nullptr;
+	std::lock_guard<std::mutex> lock(m_lock);
+	this->dropSpares();
+	for (auto &page : m_curpages) {
+		if (page != nullptr) {
+			page->close();
+			page = nullptr;
+		}
 	}
 }
 
-void PageManager::createNewPage() {
-    WriteWindow wwindow;
-    bool loaded=false;
-	if (m_curpage != nullptr) {
-        wwindow=m_curpage->getWriteWindow();
-        loaded=true;
-		m_curpage->close();
-		m_curpage = nullptr;
+void PageManager::createNewPage(size_t lane) {
+	Page::Page_ptr full_page = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (lane >= m_curpages.size()) {
+			throw MAKE_EXCEPTION("PageManager: wrong lane");
+		}
+		WriteWindow_ptr wwindow;
+		auto &curpage = m_curpages[lane];
+		if (curpage != nullptr) {
+			wwindow = curpage->getWriteWindow();
+			full_page = curpage;
+			curpage = nullptr;
+		}
+		this->createPage(lane, wwindow.get());
+	}
+	// seal of detached page (postings, cache drop) not blocks other lanes and readers.
+	if (full_page != nullptr) {
+		full_page->close();
 	}
+}
 
+void PageManager::createPage(size_t lane, const WriteWindow *wwindow) {
+	// new page must be added to already loaded list.
+	this->loadPageList();
 	std::string page_path = getNewPageUniqueName();
 
-	m_curpage = Page::Create(page_path, this->default_page_size);
-    if(loaded){
-        m_curpage->setWriteWindow(wwindow);
+	Page::Page_ptr page = nullptr;
+	if (m_spares.size() < m_curpages.size()) {
+		m_spares.resize(m_curpages.size());
+	}
+	if (m_spares[lane].valid()) {
+		try {
+			page = m_spares[lane].get();
+		} catch (std::exception &ex) {
+			logger_info("PageManager: spare page error: " << ex.what());
+		}
+		if ((page != nullptr) && (page->size() != this->default_page_size)) {
+			auto fname = page->fileName();
+			page->close();
+			page = nullptr;
+			this->removePage(fname);
+		}
+	}
+	if (page != nullptr) {
+		page->rename(page_path);
+		page->setLane(static_cast<uint32_t>(lane), static_cast<uint32_t>(m_curpages.size()));
+	} else {
+		page = Page::Create(page_path, this->default_page_size,
+		                    static_cast<uint32_t>(lane), static_cast<uint32_t>(m_curpages.size()),
+		                    m_map_options);
+	}
+	page->setBuildPostings(m_build_postings);
+    if(wwindow != nullptr){
+        page->setWriteWindow(*wwindow);
     }
+	m_curpages[lane] = page;
 	m_page_list.push_back(page_path);
+	if (m_spare_pages) {
+		this->prepareSpare(lane);
+	}
+}
+
+void PageManager::prepareSpare(size_t lane) {
+	auto fname = this->spareName(lane);
+	auto size = this->default_page_size;
+	auto options = m_map_options;
+	m_spares[lane] = std::async(std::launch::async, [fname, size, options]() {
+		return Page::Create(fname, size, 0, 1, options);
+	});
+}
+
+void PageManager::dropSpares() {
+	for (auto &spare : m_spares) {
+		if (!spare.valid()) {
+			continue;
+		}
+		try {
+			auto page = spare.get();
+			auto fname = page->fileName();
+			page->close();
+			this->removePage(fname);
+		} catch (std::exception &ex) {
+			logger_info("PageManager: spare page error: " << ex.what());
+		}
+	}
+}
+
+std::string PageManager::spareName(size_t lane)const {
+	return (fs::path(m_path) / (std::to_string(lane) + spare_page_ext)).string();
+}
+
+void PageManager::setSparePages(bool flg) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_spare_pages = flg;
+	if (!flg) {
+		this->dropSpares();
+		return;
+	}
+	m_spares.resize(m_curpages.size());
+	for (size_t lane = 0; lane < m_spares.size(); ++lane) {
+		if (!m_spares[lane].valid()) {
+			this->prepareSpare(lane);
+		}
+	}
+}
+
+bool PageManager::sparePages()const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_spare_pages;
+}
+
+void PageManager::setMapOptions(const MapOptions &options) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_map_options = options;
+}
+
+MapOptions PageManager::mapOptions()const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_map_options;
+}
+
+void PageManager::setBuildPostings(bool flg) {
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_build_postings = flg;
+	for (auto &page : m_curpages) {
+		if (page != nullptr) {
+			page->setBuildPostings(flg);
+		}
+	}
+}
+
+bool PageManager::buildPostings()const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_build_postings;
+}
+
+void PageManager::removePage(const std::string &fname) {
+	m_page_list.remove(fname);
+	IndexCache::get()->erasePage(fname);
+	fs::remove(fname);
+	fs::remove(fname + "i");
+	fs::remove(fname + "w");
+	fs::remove(fname + "p");
+	fs::remove(fname + "p.tmp");
 }
 
 std::string PageManager::getOldesPage()const {
 	return this->getOldesPage(this->pageList());
 }
+std::vector<std::string> PageManager::lastPages()const {
+	std::map<uint32_t, std::list<std::string>> lane_pages;
+	for (auto p : this->pageList()) {
+		lane_pages[Page::ReadHeader(p).lane].push_back(p);
+	}
+	std::vector<std::string> result;
+	for (auto &kv : lane_pages) {
+		result.push_back(this->getOldesPage(kv.second));
+	}
+	return result;
+}
+
 std::string PageManager::getOldesPage(const std::list<std::string> &pages)const {
 	if (pages.size() == 1)
 		return pages.front();
@@ -81,6 +289,10 @@ std::string PageManager::getOldesPage(const std::list<std::string> &pages)const
 }
 
 std::string PageManager::getNewPageUniqueName()const {
+	return uniquePageName(m_path);
+}
+
+std::string PageManager::uniquePageName(const std::string &path) {
 	fs::path page_path;
 	uint32_t suffix = 0;
 
@@ -93,14 +305,14 @@ std::string PageManager::getNewPageUniqueName()const {
 		std::stringstream ss;
 		ss << std::time(nullptr) << '_' << suffix << ".page";
 		++suffix;
-		page_path /= fs::path(m_path);
+		page_path /= fs::path(path);
 		page_path /= fs::path(ss.str());
 	}
 
 	return page_path.string();
 }
 
-std::list<std::string> PageManager::pageList() const {
+void PageManager::loadPageList() const {
 	if (m_page_list.size() == 0) {
 		auto page_list = utils::ls(m_path, ".page");
 
@@ -108,12 +320,24 @@ std::list<std::string> PageManager::pageList() const {
 			m_page_list.push_back(it->string());
 		}
 	}
+}
+
+std::list<std::string> PageManager::pageList() const {
+	std::lock_guard<std::mutex> lock(m_lock);
+	this->loadPageList();
 	return m_page_list;
 }
 
 Page::Page_ptr PageManager::open(std::string path,bool readOnly) {
-	m_curpage = Page::Open(path, readOnly);
-    return m_curpage;
+	auto page = Page::Open(path, readOnly, this->mapOptions());
+	auto lane = page->getHeader().lane;
+	std::lock_guard<std::mutex> lock(m_lock);
+	page->setBuildPostings(m_build_postings);
+	if (lane >= m_curpages.size()) {
+		m_curpages.resize(lane + 1);
+	}
+	m_curpages[lane] = page;
+    return page;
 }
 
 std::vector<PageManager::PageInfo> PageManager::pagesByTime()const {
@@ -0,0 +1,124 @@
+#include "postings.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+using namespace mdb;
+
+void Postings::encode(uint64_t value, std::vector<uint8_t> *output) {
+  while (value >= 0x80) {
+    output->push_back(uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  output->push_back(uint8_t(value));
+}
+
+uint64_t Postings::decode(const uint8_t **pos, const uint8_t *end) {
+  uint64_t result = 0;
+  int shift = 0;
+  while (true) {
+    if ((*pos >= end) || (shift > 63)) {
+      throw MAKE_EXCEPTION("postings: broken varint");
+    }
+    auto byte = **pos;
+    (*pos)++;
+    result |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return result;
+    }
+    shift += 7;
+  }
+}
+
+void Postings::Build(const std::string &fname, const Meas *values, uint64_t count) {
+  std::vector<std::pair<Id, uint64_t>> id_pos(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    id_pos[i] = std::make_pair(values[i].id, i);
+  }
+  std::sort(id_pos.begin(), id_pos.end());
+
+  std::vector<Entry> entries;
+  std::vector<uint8_t> data;
+  uint64_t prev_pos = 0;
+  for (auto &kv : id_pos) {
+    if (entries.empty() || (entries.back().id != kv.first)) {
+      entries.push_back(Entry{kv.first, data.size(), 0});
+      prev_pos = 0;
+    }
+    encode(kv.second - prev_pos, &data);
+    prev_pos = kv.second;
+    entries.back().count++;
+  }
+
+  auto tmp_name = fname + ".tmp";
+  FILE *file = std::fopen(tmp_name.c_str(), "wb");
+  if (file == nullptr) {
+    throw MAKE_EXCEPTION("can't create postings file: " + tmp_name);
+  }
+  Header hdr;
+  hdr.format = postings_file_format;
+  hdr.ids_count = entries.size();
+  bool ok = std::fwrite(&hdr, sizeof(Header), 1, file) == 1;
+  ok = ok && (std::fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size());
+  ok = ok && (std::fwrite(data.data(), 1, data.size(), file) == data.size());
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok || (std::rename(tmp_name.c_str(), fname.c_str()) != 0)) {
+    std::remove(tmp_name.c_str());
+    throw MAKE_EXCEPTION("postings write error: " + fname);
+  }
+}
+
+Postings::Postings_ptr Postings::Load(const std::string &fname) {
+  FILE *file = std::fopen(fname.c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  auto result = std::make_shared<Postings>();
+  Header hdr;
+  bool ok = (std::fread(&hdr, sizeof(Header), 1, file) == 1) && (hdr.format == postings_file_format);
+  if (ok) {
+    result->m_entries.resize(hdr.ids_count);
+    ok = std::fread(result->m_entries.data(), sizeof(Entry), hdr.ids_count, file) == hdr.ids_count;
+  }
+  if (ok && !result->m_entries.empty()) {
+    // data size: from offset of last list to end of file.
+    auto data_begin = std::ftell(file);
+    std::fseek(file, 0, SEEK_END);
+    auto data_size = std::ftell(file) - data_begin;
+    std::fseek(file, data_begin, SEEK_SET);
+    result->m_data.resize(data_size);
+    ok = std::fread(result->m_data.data(), 1, data_size, file) == size_t(data_size);
+  }
+  std::fclose(file);
+  if (!ok) {
+    throw MAKE_EXCEPTION("postings read error: " + fname);
+  }
+  return result;
+}
+
+std::vector<uint64_t> Postings::positions(const IdArray &ids) const {
+  std::vector<uint64_t> result;
+  for (auto id : ids) {
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), id,
+                               [](const Entry &e, Id v) { return e.id < v; });
+    if ((it == m_entries.end()) || (it->id != id)) {
+      continue;
+    }
+    auto middle = result.size();
+    if (it->offset > m_data.size()) {
+      throw MAKE_EXCEPTION("postings: offset out of data");
+    }
+    const uint8_t *pos = m_data.data() + it->offset;
+    const uint8_t *end = m_data.data() + m_data.size();
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < it->count; ++i) {
+      value += decode(&pos, end);
+      result.push_back(value);
+    }
+    std::inplace_merge(result.begin(), result.begin() + middle, result.end());
+  }
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
@@ -1,6 +1,9 @@
 #include "page.h"
 #include "readers.h"
 #include "exception.h"
+#include "kernels.h"
+
+#include <algorithm>
 
 #include <sstream>
 
@@ -14,6 +17,7 @@ PageReaderInterval::PageReaderInterval(Page::Page_ptr page):PageReader(page),
     m_cur_pos_end=m_cur_pos_begin=0;
 
     isWindowReader = false;
+    inTimeRange = false;
     m_wwWindowReader_read_end = false;
     values_in_point_reader = false;
 }
@@ -39,7 +43,7 @@ void PageReaderInterval::readNext(Meas::MeasList*output){
     }
 
     if (this->from > this->m_page->getHeader().maxTime) {
-        for (auto wwIt : this->m_page->getWriteWindow()) {
+        for (auto wwIt : *this->m_page->getWriteWindow()) {
             auto readedValue = wwIt;
             if (checkValueFlags(readedValue)) {
                 output->push_back(readedValue);
@@ -56,6 +60,41 @@ void PageReaderInterval::readNext(Meas::MeasList*output){
         }
     }
 
+    auto values = this->scanBlock(&m_selection);
+    for (auto pos : m_selection) {
+        output->push_back(values[pos]);
+    }
+}
+
+bool PageReaderInterval::readNextSpan(MeasSpan*span) {
+    span->clear();
+    if (isEnd()) {
+        return false;
+    }
+    span->pin = shared_from_this();
+    if (this->from > this->m_page->getHeader().maxTime) {
+        // values of write window.
+        return PageReader::readNextSpan(span);
+    }
+    if ((from > this->m_page->getHeader().minTime) && !values_in_point_reader) {
+        Meas::MeasList prefix;
+        timePointRead(from, &prefix);
+        values_in_point_reader = true;
+        if (!prefix.empty()) {
+            span->buffer.assign(prefix.begin(), prefix.end());
+            span->values = span->buffer.data();
+            span->count = span->buffer.size();
+            return true;
+        }
+    }
+    auto begin = m_cur_pos_begin;
+    span->values = this->scanBlock(&span->selection);
+    span->count = m_cur_pos_begin - begin;
+    span->filtered = true;
+    return true;
+}
+
+const Meas *PageReaderInterval::scanBlock(std::vector<uint32_t> *selection) {
     if(m_cur_pos_begin==m_cur_pos_end){
         /// get next read interval
         auto pos=m_read_pos_list.front();
@@ -64,38 +103,30 @@ void PageReaderInterval::readNext(Meas::MeasList*output){
         m_cur_pos_begin=pos.first;
         m_cur_pos_end=pos.second;
     }
-    auto read_to=(m_cur_pos_begin+PageReader::ReadSize);
-    uint64_t i=0;
-    for (i = m_cur_pos_begin; i < read_to; ++i) {
-        if(i==m_cur_pos_end){
-            break;
-        }
-        mdb::Meas readedValue;
-        if (!m_page->read(&readedValue, i)) {
-            std::stringstream ss;
-            ss << "PageReader::readNext: "
-               << " file name: " << m_page->fileName()
-               << " readPos: " << i
-               << " size: " << m_page->getHeader().size;
-
-            throw MAKE_EXCEPTION(ss.str());
-        }
-
-        if ((checkValueInterval(readedValue)) && checkValueFlags(readedValue)){
-            output->push_back(readedValue);
-        }
-
+    auto read_to = std::min(m_cur_pos_begin + PageReader::ReadSize, m_cur_pos_end);
+    auto values = m_page->values(m_cur_pos_begin, read_to);
+    if (values == nullptr) {
+        std::stringstream ss;
+        ss << "PageReader::readNext: "
+           << " file name: " << m_page->fileName()
+           << " readPos: " << read_to
+           << " size: " << m_page->getHeader().size;
+
+        throw MAKE_EXCEPTION(ss.str());
     }
-    m_cur_pos_begin=i;
-}
-
 
-bool PageReaderInterval::checkValueInterval(const Meas&m)const {
-    if (utils::inInterval(from, to, m.time)) {
-        return true;
-    } else {
-        return false;
-    }
+    kernels::ScanFilter filter;
+    filter.checkTime = !inTimeRange;
+    filter.from = from;
+    filter.to = to;
+    filter.source = source;
+    filter.flag = flag;
+    filter.ids = id_filter.get();
+    auto count = static_cast<uint32_t>(read_to - m_cur_pos_begin);
+    selection->resize(count);
+    selection->resize(kernels::scan(values, count, filter, selection->data()));
+    m_cur_pos_begin = read_to;
+    return values;
 }
 
 PageReader_TimePoint::PageReader_TimePoint(Page::Page_ptr page):PageReader(page),
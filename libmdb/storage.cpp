@@ -1,11 +1,13 @@
 #include "storage.h"
 #include "page_manager.h"
 #include "exception.h"
+#include "time_utils.h"
 
 #include <ctime>
 #include <cmath>
 #include <sstream>
 #include <iterator>
+#include <map>
 
 #include <boost/filesystem.hpp>
 
@@ -13,47 +15,61 @@ namespace fs = boost::filesystem;
 
 using namespace mdb;
 
-struct MeasCmpByTime {
-  bool operator()(mdb::Meas a, mdb::Meas b) { return a.time < b.time; }
+namespace {
+std::atomic<uint64_t> storage_instances{0};
+
+/// last shard used by this thread.
+struct ThreadShardSlot {
+  uint64_t storage_id;
+  CacheShard_ptr shard;
 };
+thread_local ThreadShardSlot thread_shard{0, nullptr};
+
+/// pages of each writer lane, sorted by time. lanes without ids skipped.
+std::vector<std::vector<PageManager::PageInfo>> pagesByLane(const IdArray &ids) {
+  std::map<uint32_t, std::vector<PageManager::PageInfo>> lanes;
+  auto pages = PageManager::get()->pagesByTime();
+  std::reverse(std::begin(pages), std::end(pages));
+  for (auto &p : pages) {
+    if (HeaderLaneCheck(ids, p.header)) {
+      lanes[p.header.lane].push_back(p);
+    }
+  }
+  std::vector<std::vector<PageManager::PageInfo>> result;
+  for (auto &kv : lanes) {
+    result.push_back(kv.second);
+  }
+  return result;
+}
+}
 
 
-AsyncWriter::AsyncWriter() {}
+AsyncWriter::AsyncWriter(size_t lane) : m_storage(nullptr), m_lane(lane) {}
 
 void AsyncWriter::setStorage(Storage *storage) { m_storage = storage; }
 
 void AsyncWriter::call(const Cache::PCache data) {
   assert(m_storage != nullptr);
-
-  auto output = data->asArray();
-
-  //MeasCmpByTime time_cmp;
-  //std::sort(output, output + data->size(), time_cmp);
-
-  size_t meas_count = data->size();
-  size_t to_write = data->size();
-
-  while (to_write > 0) {
-    size_t writed = PageManager::get()->getCurPage()->append(output + (meas_count - to_write), to_write);
-    if (writed != to_write) {
-        PageManager::get()->createNewPage();
-    }
-    to_write -= writed;
-  }
-  PageManager::get()->getCurPage()->flushWriteWindow();
-  data->clear();
-  data->sync_complete();
+  m_storage->writeToPage(data, m_lane);
 }
 
 
 Storage::Storage()
-    : m_cache_pool(defaultcachePoolSize, defaultcacheSize) {
-  m_cache = m_cache_pool.getCache();
-  m_cache->setStorage(this);
-  m_cache_writer.setStorage(this);
-  m_cache_writer.start();
+    : m_cache_pool(std::make_shared<CachePool>(defaultcachePoolSize, defaultcacheSize)) {
+  m_cache = nullptr;
+  this->takeCache(m_cache);
+  this->startWriters(1);
   m_past_time = 0;
   m_closed = false;
+  m_ingest_mode = IngestMode::Locked;
+  m_instance_id = ++storage_instances;
+  m_durability = Durability::None;
+  m_sync_tickets = 0;
+  m_synced_pages = 0;
+  m_sync_period = defaultSyncPeriod;
+  m_sync_stop = true;
+  m_time_ordered = false;
+  m_reorder_window = defaultReorderWindow;
 }
 
 Storage::~Storage() { 
@@ -63,13 +79,25 @@ Storage::~Storage() {
 }
 
 void Storage::Close() {
-  if (!m_cache_writer.stoped()) {
-    this->writeCache();
-    m_cache_writer.stop();
+  this->stopSyncThread();
+  if (!m_lanes.front()->writer.stoped()) {
+    {
+      std::unique_lock<std::mutex> guard(m_write_mutex);
+      this->drainRing(&guard);
+      this->flushShards();
+      this->writeCache();
+    }
+    this->stopWriters();
+    this->drainReorder();
+  }
+  if (m_durability != Durability::None) {
+    this->sync();
   }
+  m_wal = nullptr;
 
   PageManager::get()->closeCurrentPage();
   PageManager::stop();
+  IndexCache::get()->clear();
   m_closed = true;
 }
 
@@ -100,13 +128,42 @@ Storage::Storage_ptr Storage::Open(const std::string &ds_path) {
     throw utils::Exception::CreateAndLog(POSITION, ds_path + " not exists.");
   }
 
-  auto pages = utils::ls(ds_path, ".page");
   result->m_path = std::string(ds_path);
 
   PageManager::start(result->m_path);
-  std::string maxTimePage = PageManager::get()->getOldesPage();
-  PageManager::get()->open(maxTimePage);
+  // lane 0 always exists, its last page created with current count of lanes.
+  auto last_pages = PageManager::get()->lastPages();
+  if (last_pages.empty()) {
+    throw MAKE_EXCEPTION("open error. page not found.");
+  }
+  auto last_header = Page::ReadHeader(last_pages.front());
+  PageManager::get()->default_page_size = last_header.size;
+  auto lanes = std::max(last_header.lanes, uint32_t(1));
+  if (lanes != 1) {
+    result->setWriterLanes(lanes);
+  }
+  for (auto &page : last_pages) {
+    if (Page::ReadHeader(page).lane < lanes) {
+      PageManager::get()->open(page);
+    }
+  }
 
+  // values, which was in caches on crash.
+  auto logged = WAL::readAll(ds_path);
+  if (!logged.empty()) {
+    logger_info("Storage: replay " << logged.size() << " values from WAL.");
+    std::vector<Meas> values(logged.begin(), logged.end());
+    // log is the only durable copy of values: pages filled by replay synced on rollover.
+    result->m_sync_tickets++;
+    result->append(values.data(), values.size());
+    {
+      std::lock_guard<std::mutex> guard(result->m_write_mutex);
+      result->flush_and_stop();
+    }
+    result->syncPages();
+    result->m_sync_tickets--;
+  }
+  WAL::removeAll(ds_path);
   return result;
 }
 
@@ -115,10 +172,25 @@ bool Storage::havePage2Write() const {
 }
 
 append_result Storage::append(const Meas& m) {
-  std::lock_guard<std::mutex> guard(m_write_mutex);
+  if (m_ingest_mode == IngestMode::LockFreeRing) {
+    auto value = m;
+    return this->appendToRing(&value, 1);
+  }
+  if (m_ingest_mode == IngestMode::ThreadShards) {
+    auto value = m;
+    return this->appendToShard(&value, 1);
+  }
+  std::unique_lock<std::mutex> guard(m_write_mutex);
   append_result res{};
   while (res.writed == 0) {
+    if (!this->takeCache(m_cache, &guard)) {
+      res.writed = res.ignored = 1;
+      m_cache_pool->addDropped(1);
+      break;
+    }
+    auto before = m_cache->size();
     res = m_cache->append(m, m_past_time);
+    this->logToWal(m_cache, before);
     if (res.writed == 0) {
       this->writeCache();
     }
@@ -130,46 +202,603 @@ append_result Storage::append(const Meas& m) {
 }
 
 append_result Storage::append(const Meas::PMeas begin, const size_t meas_count) {
-  std::lock_guard<std::mutex> guard(m_write_mutex);
-  if (m_cache->isFull()) {
-    this->writeCache();
+  if (m_ingest_mode == IngestMode::LockFreeRing) {
+    return this->appendToRing(begin, meas_count);
+  }
+  if (m_ingest_mode == IngestMode::ThreadShards) {
+    return this->appendToShard(begin, meas_count);
   }
+  std::unique_lock<std::mutex> guard(m_write_mutex);
+  auto result = this->appendToCache(m_cache, begin, meas_count, m_past_time, nullptr, &guard);
+  if (result.ignored != 0) {
+	  logger_info("DataStorage: ignored on write:" << result.ignored);
+  }
+  return result;
+}
+
+append_result Storage::append(const MeasColumns &columns) {
+  append_result result{};
+  if (m_ingest_mode == IngestMode::LockFreeRing) {
+    // ring stores Meas, so rows are converted by small chunks.
+    const size_t chunk_size = 256;
+    Meas chunk[chunk_size];
+    for (size_t row = 0; row < columns.count; row += chunk_size) {
+      auto count = std::min(chunk_size, columns.count - row);
+      for (size_t i = 0; i < count; ++i) {
+        chunk[i] = columns.at(row + i);
+      }
+      result = result + this->appendToRing(chunk, count);
+    }
+    return result;
+  }
+  if (m_ingest_mode == IngestMode::ThreadShards) {
+    auto shard = this->threadShard();
+    std::unique_lock<std::mutex> guard(shard->lock);
+    result = this->appendToCache(shard->cache, columns, m_past_time, &guard);
+  } else {
+    std::unique_lock<std::mutex> guard(m_write_mutex);
+    result = this->appendToCache(m_cache, columns, m_past_time, &guard);
+  }
+  if (result.ignored != 0) {
+    logger_info("DataStorage: ignored on write:" << result.ignored);
+  }
+  return result;
+}
+
+append_result Storage::appendToCache(Cache::PCache &cache, const MeasColumns &columns,
+                                     const Time past_time, std::unique_lock<std::mutex> *lock) {
+  size_t from = 0;
+  append_result result{};
+  while (from < columns.count) {
+    if (!this->takeCache(cache, lock)) {
+      auto to_write = columns.count - from;
+      result.writed += to_write;
+      result.ignored += to_write;
+      m_cache_pool->addDropped(to_write);
+      break;
+    }
+    auto before = cache->size();
+    auto wrt_res = cache->append(columns, from, past_time);
+    this->logToWal(cache, before);
+
+    if (from + wrt_res.writed != columns.count) {
+      this->sendCache(cache);
+    }
+    from += wrt_res.writed;
+    result = result + wrt_res;
+  }
+  return result;
+}
+
+void Storage::appendAsync(const Meas::PMeas begin, const size_t meas_count,
+                          AppendTicket::Callback callback, bool sync) {
+  auto ticket = std::make_shared<AppendTicket>(callback, sync);
+  if (sync) {
+    // pages, filled before ticket complete, are synced on rollover.
+    m_sync_tickets++;
+  }
+  if (m_ingest_mode == IngestMode::ThreadShards) {
+    auto shard = this->threadShard();
+    std::unique_lock<std::mutex> guard(shard->lock);
+    ticket->result = this->appendToCache(shard->cache, begin, meas_count, m_past_time, ticket, &guard);
+    this->sendCache(shard->cache);
+  } else {
+    // ring values can`t hold ticket, so values of async append go to cache directly.
+    std::unique_lock<std::mutex> guard(m_write_mutex);
+    this->drainRing(&guard);
+    ticket->result = this->appendToCache(m_cache, begin, meas_count, m_past_time, ticket, &guard);
+    this->sendCache(m_cache);
+  }
+  if (ticket->result.ignored != 0) {
+    logger_info("DataStorage: ignored on write:" << ticket->result.ignored);
+  }
+  // part of producer.
+  this->releaseTicket(ticket);
+}
+
+std::future<append_result> Storage::appendAsync(const Meas::PMeas begin, const size_t meas_count,
+                                                bool sync) {
+  auto promise = std::make_shared<std::promise<append_result>>();
+  auto result = promise->get_future();
+  this->appendAsync(begin, meas_count,
+                    [promise](append_result res) { promise->set_value(res); }, sync);
+  return result;
+}
+
+void Storage::releaseTicket(const AppendTicket_ptr &ticket) {
+  if (!ticket->release()) {
+    return;
+  }
+  if (ticket->sync) {
+    this->syncPages();
+    m_sync_tickets--;
+  }
+  ticket->complete();
+}
+
+void Storage::releaseTickets(const AppendTickets &tickets) {
+  for (auto &t : tickets) {
+    this->releaseTicket(t);
+  }
+}
+
+append_result Storage::appendToCache(Cache::PCache &cache, const Meas::PMeas begin,
+                                     const size_t meas_count, const Time past_time,
+                                     const AppendTicket_ptr &ticket, std::unique_lock<std::mutex> *lock) {
   size_t to_write = meas_count;
   append_result result{};
   while (to_write > 0) {
+    if (!this->takeCache(cache, lock)) {
+      result.writed += to_write;
+      result.ignored += to_write;
+      m_cache_pool->addDropped(to_write);
+      break;
+    }
+    auto before = cache->size();
     auto wrt_res =
-        m_cache->append(begin + (meas_count - to_write), to_write, m_past_time);
+        cache->append(begin + (meas_count - to_write), to_write, past_time);
+    this->logToWal(cache, before);
+    if ((ticket != nullptr) && (cache->size() != before)) {
+      cache->addTicket(ticket);
+    }
 
     if (wrt_res.writed != to_write) {
-      this->writeCache();
+      this->sendCache(cache);
     }
     to_write -= wrt_res.writed;
     result = result + wrt_res;
   }
+  return result;
+}
+
+append_result Storage::appendToRing(const Meas::PMeas begin, const size_t meas_count) {
+  append_result result{};
+  result.writed = meas_count;
+  auto cur_time = m_past_time == 0 ? 0 : TimeWork::CurrentUtcTime();
+  for (size_t i = 0; i < meas_count; ++i) {
+    if (!checkPastTime(begin[i].time, m_past_time, cur_time)) {
+      result.ignored++;
+      continue;
+    }
+    // visible to curValues before ring drained.
+    m_cur_values.writeValue(begin[i]);
+    while (!m_ring->try_push(begin[i])) {
+      // ring is full: help to drain it.
+      std::unique_lock<std::mutex> guard(m_write_mutex);
+      this->drainRing(&guard);
+    }
+  }
+  // whoever wins the lock moves values to the cache, others just go on.
+  std::unique_lock<std::mutex> guard(m_write_mutex, std::try_to_lock);
+  if (guard.owns_lock()) {
+    this->drainRing(&guard);
+  }
   if (result.ignored != 0) {
-	  logger_info("DataStorage: ignored on write:" << result.ignored);
+    logger_info("DataStorage: ignored on write:" << result.ignored);
+  }
+  return result;
+}
+
+void Storage::drainRing(std::unique_lock<std::mutex> *lock) {
+  if (m_ring == nullptr) {
+    return;
+  }
+  const size_t drain_batch = 256;
+  Meas batch[drain_batch];
+  while (true) {
+    size_t count = 0;
+    while ((count < drain_batch) && m_ring->try_pop(&batch[count])) {
+      count++;
+    }
+    if (count == 0) {
+      break;
+    }
+    // values already checked by past time and written to cur values in appendToRing.
+    size_t pos = 0;
+    while (pos < count) {
+      this->takeCache(m_cache, lock, false);
+      auto before = m_cache->size();
+      auto wrt_res = m_cache->append(batch + pos, count - pos, 0, false);
+      this->logToWal(m_cache, before);
+      pos += wrt_res.writed;
+      if (pos != count) {
+        this->sendCache(m_cache);
+      }
+    }
+  }
+}
+
+CacheShard_ptr Storage::threadShard() {
+  if ((thread_shard.storage_id == m_instance_id) && (thread_shard.shard != nullptr)) {
+    return thread_shard.shard;
+  }
+
+  std::lock_guard<std::mutex> guard(m_shards_lock);
+  auto this_thread = std::this_thread::get_id();
+  CacheShard_ptr result = nullptr;
+  for (auto &shard : m_shards) {
+    if (shard->owner == this_thread) {
+      result = shard;
+      break;
+    }
+  }
+  if (result == nullptr) {
+    result = std::make_shared<CacheShard>();
+    result->owner = this_thread;
+    result->cache = nullptr;
+    m_shards.push_back(result);
   }
+  thread_shard.storage_id = m_instance_id;
+  thread_shard.shard = result;
   return result;
 }
 
+append_result Storage::appendToShard(const Meas::PMeas begin, const size_t meas_count) {
+  auto shard = this->threadShard();
+  std::unique_lock<std::mutex> guard(shard->lock);
+
+  auto result = this->appendToCache(shard->cache, begin, meas_count, m_past_time, nullptr, &guard);
+  if (result.ignored != 0) {
+    logger_info("DataStorage: ignored on write:" << result.ignored);
+  }
+  return result;
+}
+
+void Storage::flushShards() {
+  std::lock_guard<std::mutex> guard(m_shards_lock);
+  for (auto &shard : m_shards) {
+    std::lock_guard<std::mutex> shard_guard(shard->lock);
+    this->sendCache(shard->cache);
+  }
+}
+
+bool Storage::takeCache(Cache::PCache &cache, std::unique_lock<std::mutex> *lock, bool can_drop) {
+  while (cache == nullptr) {
+    cache = m_cache_pool->tryGetCache();
+    if (cache != nullptr) {
+      cache->setStorage(this);
+      break;
+    }
+    if (can_drop && (m_cache_pool->policy() == PoolPolicy::Drop)) {
+      return false;
+    }
+    // writers release caches, while lock is free. other thread may take cache after wait.
+    if (lock != nullptr) {
+      lock->unlock();
+    }
+    m_cache_pool->waitCache();
+    if (lock != nullptr) {
+      lock->lock();
+    }
+  }
+  return true;
+}
+
+void Storage::logToWal(Cache::PCache &cache, size_t from) {
+  if ((m_wal == nullptr) || (cache->size() <= from)) {
+    return;
+  }
+  m_wal->append(cache->asArray() + from, cache->size() - from, cache->walSegments());
+}
+
+void Storage::sendCache(Cache::PCache &cache) {
+  if ((cache == nullptr) || (cache->size() == 0)) {
+    return;
+  }
+  cache->sync_begin();
+  if ((m_wal != nullptr) && !cache->walSegments().empty()) {
+    cache->setWalHold(std::make_shared<WALHold>(m_wal.get(), std::move(cache->walSegments())));
+    cache->walSegments().clear();
+  }
+  cache->setPendingLanes(m_lanes.size());
+  if (m_time_ordered) {
+    // in reorder buffer values of each lane written to page separately.
+    for (auto &t : cache->tickets()) {
+      t->addPending(m_lanes.size() - 1);
+    }
+  }
+  for (auto &lane : m_lanes) {
+    lane->writer.add(cache);
+  }
+  cache = nullptr;
+}
+
 void Storage::writeCache() {
-  if (m_cache->size() == 0) {
+  this->sendCache(m_cache);
+}
+
+void Storage::writeToPage(const Cache::PCache data, size_t lane) {
+  auto &wl = *m_lanes[lane];
+  AppendTickets done;
+  {
+    std::lock_guard<std::mutex> guard(wl.page_lock);
+    auto output = data->asArray();
+    size_t meas_count = data->size();
+    if ((m_lanes.size() > 1) || m_time_ordered) {
+      wl.buffer.clear();
+      for (size_t i = 0; i < data->size(); ++i) {
+        if (Page::laneOf(output[i].id, uint32_t(m_lanes.size())) == lane) {
+          wl.buffer.push_back(output[i]);
+        }
+      }
+      output = wl.buffer.data();
+      meas_count = wl.buffer.size();
+    }
+
+    if (m_time_ordered) {
+      this->reorderToPage(lane, output, meas_count, data->walHold(), data->tickets());
+      done.swap(wl.done_tickets);
+    } else {
+      this->writeToLanePage(lane, output, meas_count);
+    }
+  }
+  this->releaseTickets(done);
+  if (!data->laneComplete()) {
     return;
   }
-  
-  m_cache->sync_begin();
+  if (!m_time_ordered) {
+    done = data->tickets();
+  }
+  // last lane wrote cache, its WAL segments released with hold.
+  data->clear();
+  data->sync_complete();
+  if (!m_time_ordered) {
+    this->releaseTickets(done);
+  }
+}
 
-  m_cache_writer.add(m_cache);
+void Storage::writeToLanePage(size_t lane, const Meas::PMeas output, size_t meas_count) {
+  if (meas_count == 0) {
+    return;
+  }
+  size_t to_write = meas_count;
 
-  // FIX must use more smart method.
-  m_cache = nullptr;
-  while (true) {
-    m_cache = m_cache_pool.getCache();
-    if (m_cache != nullptr) {
+  while (to_write > 0) {
+    auto page = PageManager::get()->getCurPage(lane);
+    if (page == nullptr) {
+      PageManager::get()->createNewPage(lane);
+      continue;
+    }
+    size_t writed = page->append(output + (meas_count - to_write), to_write);
+    if (writed != to_write) {
+      if ((m_durability != Durability::None) || (m_sync_tickets.load() != 0)) {
+        this->syncPage(page);
+      }
+      PageManager::get()->createNewPage(lane);
+    }
+    to_write -= writed;
+  }
+  auto page = PageManager::get()->getCurPage(lane);
+  if (m_durability == Durability::GroupCommit) {
+    this->syncPage(page);
+  } else {
+    page->flush();
+  }
+}
+
+void Storage::reorderToPage(size_t lane, const Meas::PMeas values, size_t count,
+                            const WALHold_ptr &hold, const AppendTickets &tickets) {
+  auto &wl = *m_lanes[lane];
+  MeasCmpByTime time_cmp;
+  std::sort(values, values + count, time_cmp);
+
+  auto batch = wl.next_batch++;
+  if (count == 0) {
+    // no values of this lane in cache.
+    wl.done_tickets.insert(wl.done_tickets.end(), tickets.begin(), tickets.end());
+  } else if ((hold != nullptr) || !tickets.empty()) {
+    wl.batches[batch] = WriterLane::Batch{count, hold, tickets};
+  }
+  auto middle = wl.reorder.size();
+  for (size_t i = 0; i < count; ++i) {
+    wl.reorder.push_back(WriterLane::ReorderItem{values[i], batch});
+  }
+  std::inplace_merge(wl.reorder.begin(), wl.reorder.begin() + middle, wl.reorder.end(),
+                     [&time_cmp](const WriterLane::ReorderItem &a, const WriterLane::ReorderItem &b) {
+                       return time_cmp(a.value, b.value);
+                     });
+
+  if (!tickets.empty() && !wl.reorder.empty()) {
+    // async appends must not wait for next caches: lane buffer written whole.
+    this->emitReordered(lane, wl.reorder.size());
+  } else if (wl.reorder.size() > m_reorder_window) {
+    // oldest values, what can`t be overtaken by next caches, go to page.
+    this->emitReordered(lane, wl.reorder.size() - m_reorder_window);
+  }
+}
+
+void Storage::emitReordered(size_t lane, size_t count) {
+  auto &wl = *m_lanes[lane];
+  wl.buffer.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    wl.buffer[i] = wl.reorder[i].value;
+  }
+  this->writeToLanePage(lane, wl.buffer.data(), count);
+
+  // values on page, release WAL segments of batches without values in buffer.
+  for (size_t i = 0; i < count; ++i) {
+    auto it = wl.batches.find(wl.reorder[i].batch);
+    if ((it != wl.batches.end()) && (--it->second.remaining == 0)) {
+      auto &tickets = it->second.tickets;
+      wl.done_tickets.insert(wl.done_tickets.end(), tickets.begin(), tickets.end());
+      wl.batches.erase(it);
+    }
+  }
+  wl.reorder.erase(wl.reorder.begin(), wl.reorder.begin() + count);
+}
+
+void Storage::drainReorder() {
+  for (size_t i = 0; i < m_lanes.size(); ++i) {
+    AppendTickets done;
+    {
+      std::lock_guard<std::mutex> guard(m_lanes[i]->page_lock);
+      if (!m_lanes[i]->reorder.empty()) {
+        this->emitReordered(i, m_lanes[i]->reorder.size());
+      }
+      done.swap(m_lanes[i]->done_tickets);
+    }
+    this->releaseTickets(done);
+  }
+}
+
+void Storage::setTimeOrdered(bool flg, size_t reorder_window) {
+  std::lock_guard<std::mutex> guard(m_write_mutex);
+  this->flush_and_stop();
+  m_time_ordered = flg;
+  m_reorder_window = reorder_window;
+}
+
+bool Storage::timeOrdered() const {
+  return m_time_ordered;
+}
+
+void Storage::setSparePages(bool flg) {
+  PageManager::get()->setSparePages(flg);
+}
+
+bool Storage::sparePages() const {
+  return PageManager::get()->sparePages();
+}
+
+void Storage::enablePostings(bool flg) {
+  PageManager::get()->setBuildPostings(flg);
+}
+
+bool Storage::postingsEnabled() const {
+  return PageManager::get()->buildPostings();
+}
+
+void Storage::setMapOptions(const MapOptions &options) {
+  PageManager::get()->setMapOptions(options);
+}
+
+MapOptions Storage::mapOptions() const {
+  return PageManager::get()->mapOptions();
+}
+
+void Storage::syncPages() {
+  if (PageManager::get() == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < m_lanes.size(); ++i) {
+    std::lock_guard<std::mutex> guard(m_lanes[i]->page_lock);
+    auto page = PageManager::get()->getCurPage(i);
+    if (page != nullptr) {
+      this->syncPage(page);
+    }
+  }
+}
+
+void Storage::syncPage(const Page::Page_ptr &page) {
+  page->sync();
+  m_synced_pages++;
+}
+
+uint64_t Storage::syncedPagesCount() const {
+  return m_synced_pages.load();
+}
+
+void Storage::sync() {
+  this->syncPages();
+  std::lock_guard<std::mutex> guard(m_write_mutex);
+  if (m_wal != nullptr) {
+    m_wal->sync();
+  }
+}
+
+void Storage::startWriters(size_t lanes) {
+  m_lanes.clear();
+  for (size_t i = 0; i < lanes; ++i) {
+    WriterLane_ptr lane(new WriterLane(i));
+    lane->writer.setStorage(this);
+    lane->writer.start();
+    m_lanes.push_back(std::move(lane));
+  }
+}
+
+void Storage::stopWriters() {
+  for (auto &lane : m_lanes) {
+    lane->writer.stop();
+  }
+}
+
+bool Storage::writersBusy() const {
+  for (auto &lane : m_lanes) {
+    if (lane->writer.isBusy()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Storage::pauseWriters() {
+  for (auto &lane : m_lanes) {
+    lane->writer.pause_work();
+  }
+}
+
+void Storage::continueWriters() {
+  for (auto &lane : m_lanes) {
+    lane->writer.continue_work();
+  }
+}
+
+void Storage::setWriterLanes(size_t lanes) {
+  if (lanes == 0) {
+    throw MAKE_EXCEPTION("Storage: writer lanes count must be > 0");
+  }
+  std::lock_guard<std::mutex> guard(m_write_mutex);
+  this->flush_and_stop();
+  this->stopWriters();
+  if (PageManager::get() != nullptr) {
+    PageManager::get()->setLanes(lanes);
+  }
+  this->startWriters(lanes);
+}
+
+size_t Storage::writerLanes() const {
+  return m_lanes.size();
+}
+
+void Storage::setDurability(Durability mode, uint64_t period_ms) {
+  this->stopSyncThread();
+  m_durability = mode;
+  m_sync_period = period_ms;
+  if (m_durability == Durability::Periodic) {
+    this->startSyncThread();
+  }
+}
+
+Durability Storage::durability() const {
+  return m_durability;
+}
+
+void Storage::startSyncThread() {
+  m_sync_stop = false;
+  m_sync_thread = std::thread(&Storage::syncThreadFunc, this);
+}
+
+void Storage::stopSyncThread() {
+  {
+    std::lock_guard<std::mutex> lock(m_sync_mutex);
+    if (m_sync_stop) {
+      return;
+    }
+    m_sync_stop = true;
+    m_sync_cond.notify_one();
+  }
+  m_sync_thread.join();
+}
+
+void Storage::syncThreadFunc() {
+  std::unique_lock<std::mutex> lock(m_sync_mutex);
+  while (!m_sync_stop) {
+    m_sync_cond.wait_for(lock, std::chrono::milliseconds(m_sync_period));
+    if (m_sync_stop) {
       break;
     }
+    this->sync();
   }
-  m_cache->setStorage(this);
 }
 
 StorageReader_ptr Storage::readInterval(Time from, Time to) {
@@ -186,71 +815,72 @@ StorageReader_ptr Storage::readInterval(const IdArray &ids,
     auto sr=new StorageReader();
     StorageReader_ptr result(sr);
 
-    this->m_cache_writer.pause_work();
+    this->pauseWriters();
 
-    auto pages = PageManager::get()->pagesByTime();
-	std::reverse(std::begin(pages), std::end(pages));
+	for (auto &pages : pagesByLane(ids)) {
+		std::list<std::string> pages_to_read{};
+		std::string prev_interval_page = "";
 
-	std::list<std::string> pages_to_read{};
+		for (size_t i=0;i<pages.size();i++) {
+			auto pinfo = pages[i];
+			auto page_name = pinfo.name;
+			auto hdr = pinfo.header;
 
-	
-    for (size_t i=0;i<pages.size();i++) {
-		auto pinfo = pages[i];
-		auto page_name = pinfo.name;
-		auto hdr = pinfo.header;
-
-		// [min from to max]
-		if ((hdr.minTime <= from) && (hdr.maxTime >= to)) {
-			pages_to_read.push_back(page_name);
-			if (i>0) {
-				if ((result->prev_interval_page == "") && (pages_to_read.size()==1)) {
-					result->prev_interval_page = pages[i - 1].name;
+			// [min from to max]
+			if ((hdr.minTime <= from) && (hdr.maxTime >= to)) {
+				pages_to_read.push_back(page_name);
+				if (i>0) {
+					if ((prev_interval_page == "") && (pages_to_read.size()==1)) {
+						prev_interval_page = pages[i - 1].name;
+					}
 				}
+				continue;
 			}
-			continue;
-		}
 
-        // [min from max]
-        if ((hdr.minTime <= from) && (hdr.maxTime> from)) {
+			// [min from max]
+			if ((hdr.minTime <= from) && (hdr.maxTime> from)) {
 				pages_to_read.push_back(page_name);
 				if (i>0) {
-					result->prev_interval_page = pages[i - 1].name;
+					prev_interval_page = pages[i - 1].name;
 				}
 				continue;
-		}
+			}
+
+			// [...max] from [min...]
+			if (hdr.minTime > from) {
+				if ((i > 0) && (pages[i - 1].header.maxTime <= from)) {
+					pages_to_read.push_back(pages[i - 1].name);
+					pages_to_read.push_back(page_name);
+					continue;
+				}
+			}
 
-        // [...max] from [min...]
-		if (hdr.minTime > from) {
-			if ((i > 0) && (pages[i - 1].header.maxTime <= from)) {
-				pages_to_read.push_back(pages[i - 1].name);
+			// from  [min to max]
+			if ((hdr.minTime >= from) && (hdr.maxTime >= to) && (hdr.minTime <= to)) {
 				pages_to_read.push_back(page_name);
 				continue;
 			}
-		}
 
-        // from  [min to max] 
-		if ((hdr.minTime >= from) && (hdr.maxTime >= to) && (hdr.minTime <= to)) {
-			pages_to_read.push_back(page_name);
-			continue;
+			// from  [min  max] to
+			if ((hdr.minTime >= from) && (hdr.maxTime <= to)) {
+				pages_to_read.push_back(page_name);
+				continue;
+			}
 		}
-		
-		// from  [min  max] to
-		if ((hdr.minTime >= from) && (hdr.maxTime <= to)) {
-			pages_to_read.push_back(page_name);
-			continue;
+		for (auto page_name : pages_to_read) {
+			result->addPage(page_name, prev_interval_page);
 		}
-    }
-	
+	}
+
     result->ids=ids;
+    result->id_filter=IdFilter::make(ids);
+    result->map_options=this->mapOptions();
     result->from=from;
     result->to=to;
     result->source=source;
     result->flag=flag;
-	for (auto page_name : pages_to_read) {
-        result->addPage(page_name);
-	}
 
-    this->m_cache_writer.continue_work();
+    this->continueWriters();
 
     return result;
 }
@@ -265,54 +895,55 @@ StorageReader_ptr Storage::readInTimePoint(const IdArray &ids, mdb::Flag source,
 	auto sr = new StorageReader();
 	StorageReader_ptr result(sr);
 
-	this->m_cache_writer.pause_work();
-
-	auto pages = PageManager::get()->pagesByTime();
-	std::reverse(std::begin(pages), std::end(pages));
+	this->pauseWriters();
 
-	std::list<std::string> pages_to_read{};
+	for (auto &pages : pagesByLane(ids)) {
+		std::list<std::string> pages_to_read{};
+		std::string prev_interval_page = "";
 
+		for (size_t i = 0; i<pages.size(); i++) {
+			auto pinfo = pages[i];
+			auto page_name = pinfo.name;
+			auto hdr = pinfo.header;
 
-	for (size_t i = 0; i<pages.size(); i++) {
-		auto pinfo = pages[i];
-		auto page_name = pinfo.name;
-		auto hdr = pinfo.header;
+			// [min  max] tp, pages.size==1
+			if ((hdr.minTime <= time_point) && (hdr.maxTime <= time_point)) {
+				if (pages.size() == 1) {
+					pages_to_read.push_back(page_name);
+					break;
+				}
+			}
 
-		// [min  max] tp, pages.size==1
-		if ((hdr.minTime <= time_point) && (hdr.maxTime <= time_point)) {
-			if (pages.size() == 1) {
+			// [min tp max]
+			if ((hdr.minTime <= time_point) && (hdr.maxTime >= time_point)) {
 				pages_to_read.push_back(page_name);
+				if (i>0) {
+					prev_interval_page = pages[i - 1].name;
+				}
 				break;
 			}
-		}
 
-		// [min tp max]
-		if ((hdr.minTime <= time_point) && (hdr.maxTime >= time_point)) {
-			pages_to_read.push_back(page_name);
-			if (i>0) {
-				result->prev_interval_page = pages[i - 1].name;
+			// [...max] from [min...]
+			if (hdr.minTime > time_point) {
+				if ((i > 0) && (pages[i - 1].header.maxTime <= time_point)) {
+					pages_to_read.push_back(pages[i - 1].name);
+					break;
+				}
 			}
-			break;
 		}
-
-		// [...max] from [min...]
-		if (hdr.minTime > time_point) {
-			if ((i > 0) && (pages[i - 1].header.maxTime <= time_point)) {
-				pages_to_read.push_back(pages[i - 1].name);
-				break;
-			}
+		for (auto page_name : pages_to_read) {
+			result->addPage(page_name, prev_interval_page);
 		}
 	}
 
 	result->ids = ids;
+	result->id_filter = IdFilter::make(ids);
+	result->map_options = this->mapOptions();
 	result->time_point = time_point;
 	result->source = source;
 	result->flag = flag;
-	for (auto page_name : pages_to_read) {
-		result->addPage(page_name);
-	}
 
-	this->m_cache_writer.continue_work();
+	this->continueWriters();
 
 	return result;
 }
@@ -330,9 +961,9 @@ IdArray Storage::loadCurValues(const IdArray&ids) {
 
 	IdSet id_set(ids.begin(), ids.end());
 
-	mdb::Page::Page_ptr page2read = mdb::Page::Open(page_time_vector.front().name, true);
-	WriteWindow ww = page2read->getWriteWindow();
-	for (auto m : ww) {
+	mdb::Page::Page_ptr page2read = mdb::Page::Open(page_time_vector.front().name, true, this->mapOptions());
+	auto ww = page2read->getWriteWindow();
+	for (auto m : *ww) {
 		m_cur_values.writeValue(m);
 		id_set.erase(m.id);
 	}
@@ -352,52 +983,91 @@ Time Storage::pastTime() const { return m_past_time; }
 void Storage::setPastTime(const Time &t) { m_past_time = t; }
 
 void Storage::enableCacheDynamicSize(bool flg) {
-  m_cache_pool.enableDynamicSize(flg);
+  m_cache_pool->enableDynamicSize(flg);
 }
 
 bool Storage::cacheDynamicSize() const {
-  return m_cache_pool.dynamicSize();
+  return m_cache_pool->dynamicSize();
+}
+
+void Storage::setPoolPolicy(PoolPolicy policy, size_t memory_budget) {
+  m_cache_pool->setPolicy(policy, memory_budget);
+}
+
+PoolPolicy Storage::poolPolicy() const {
+  return m_cache_pool->policy();
+}
+
+uint64_t Storage::droppedCount() const {
+  return m_cache_pool->droppedCount();
 }
 
 size_t Storage::getPoolSize()const{
-    return m_cache_pool.getPoolSize();
+    return m_cache_pool->getPoolSize();
 }
 
 void Storage::setPoolSize(size_t sz){
-    m_cache_pool.setPoolSize(sz);
+    m_cache_pool->setPoolSize(sz);
 }
 
 size_t Storage::getCacheSize()const{
-    return m_cache_pool.getCacheSize();
+    return m_cache_pool->getCacheSize();
 }
 
 void Storage::setCacheSize(size_t sz){
-    m_cache_pool.setCacheSize(sz);
+    m_cache_pool->setCacheSize(sz);
+}
+
+void Storage::setIngestMode(IngestMode mode, size_t ring_size) {
+  std::lock_guard<std::mutex> guard(m_write_mutex);
+  this->drainRing();
+  this->flushShards();
+  m_ingest_mode = mode;
+  if (mode == IngestMode::LockFreeRing) {
+    m_ring.reset(new utils::MPSCRing<Meas>(ring_size));
+  } else {
+    m_ring = nullptr;
+  }
+}
+
+void Storage::enableWal(bool flg, uint64_t segment_size) {
+  std::lock_guard<std::mutex> guard(m_write_mutex);
+  // values in caches must be released by the old log.
+  this->flush_and_stop();
+  m_wal = nullptr;
+  if (flg) {
+    m_wal.reset(new WAL(m_path, segment_size));
+  }
+}
+
+bool Storage::walEnabled() const {
+  return m_wal != nullptr;
+}
+
+IngestMode Storage::ingestMode() const {
+  return m_ingest_mode;
 }
 
 void Storage::flush_and_stop() {
+	this->drainRing();
+	this->flushShards();
 	this->writeCache();
 	while (true) {
-		if (!m_cache_writer.isBusy()) {
+		if (!this->writersBusy()) {
 			break;
 		}
 	}
+	this->drainReorder();
 }
 
 Meas::MeasList Storage::curValues(const IdArray&ids) {
-	this->writeCache();
-	while (true) {
-		if (!m_cache_writer.isBusy()) {
-			break;
-		}
-	}
+	// values writed to table on append, caches not flushed.
 	return m_cur_values.readValue(ids);
 }
 
 
 StorageReader::StorageReader():m_pages(){
     m_current_reader=nullptr;
-    prev_interval_page="";
 	time_point = 0;
 }
 
@@ -422,27 +1092,7 @@ void StorageReader::readNext(Meas::MeasList*output){
     }
 
     if(m_current_reader==nullptr){
-        auto page_name=m_pages.front();
-        m_pages.pop_front();
-        mdb::Page::Page_ptr page2read = mdb::Page::Open(page_name, true);
-
-        WriteWindow prev_ww{};
-        if (prev_interval_page != "") {
-            mdb::Page::Page_ptr prev_page2read = mdb::Page::Open(prev_interval_page, true);
-            prev_ww = prev_page2read->getWriteWindow();
-            prev_page2read->readComplete();
-        }
-
-		if (this->time_point != 0) {
-			m_current_reader = page2read->readInTimePoint(ids, source, flag, time_point);
-			m_current_reader->prev_ww = prev_ww;
-
-		}
-		else {
-			m_current_reader = page2read->readInterval(ids, source, flag, from, to);
-			m_current_reader->prev_ww=prev_ww;
-		
-		}
+        this->openNextReader();
     }
 
 	m_current_reader->readNext(output);
@@ -453,6 +1103,46 @@ void StorageReader::readNext(Meas::MeasList*output){
 	
 }
 
-void StorageReader::addPage(std::string page_name){
-    this->m_pages.push_back(page_name);
+bool StorageReader::readNextSpan(MeasSpan*span) {
+    assert(span != nullptr);
+    span->clear();
+    while (!isEnd()) {
+        if (m_current_reader == nullptr) {
+            this->openNextReader();
+        }
+        bool readed = m_current_reader->readNextSpan(span);
+        if (m_current_reader->isEnd()) {
+            m_current_reader = nullptr;
+        }
+        if (readed && (span->size() != 0)) {
+            return true;
+        }
+    }
+    span->clear();
+    return false;
+}
+
+void StorageReader::openNextReader() {
+    auto page_to_read=m_pages.front();
+    m_pages.pop_front();
+    mdb::Page::Page_ptr page2read = mdb::Page::Open(page_to_read.name, true, map_options);
+
+    WriteWindow_ptr prev_ww = std::make_shared<const WriteWindow>();
+    if (page_to_read.prev_page != "") {
+        mdb::Page::Page_ptr prev_page2read = mdb::Page::Open(page_to_read.prev_page, true, map_options);
+        prev_ww = prev_page2read->getWriteWindow();
+        prev_page2read->readComplete();
+    }
+
+	if (this->time_point != 0) {
+		m_current_reader = page2read->readInTimePoint(ids, source, flag, time_point, id_filter);
+	}
+	else {
+		m_current_reader = page2read->readInterval(ids, source, flag, from, to, id_filter);
+	}
+	m_current_reader->prev_ww = prev_ww;
+}
+
+void StorageReader::addPage(std::string page_name, std::string prev_page){
+    this->m_pages.push_back(PageToRead{page_name, prev_page});
 }
@@ -1,6 +1,14 @@
 #include "utils.h"
 #include "exception.h"
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 std::list<boost::filesystem::path> utils::ls(const std::string &path) {
     std::list<boost::filesystem::path> result;
 
@@ -60,3 +68,38 @@ std::string utils::parent_path(std::string fname) {
 
   return p.parent_path().string();
 }
+
+bool utils::sync_file(const std::string &fname) {
+#ifdef _WIN32
+  int fd = _open(fname.c_str(), _O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  bool result = _commit(fd) == 0;
+  _close(fd);
+#else
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool result = ::fsync(fd) == 0;
+  ::close(fd);
+#endif
+  return result;
+}
+
+bool utils::preallocate_file(const std::string &fname, uint64_t size) {
+#ifdef _WIN32
+  (void)fname;
+  (void)size;
+  return false;
+#else
+  int fd = ::open(fname.c_str(), O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  bool result = ::posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+  ::close(fd);
+  return result;
+#endif
+}
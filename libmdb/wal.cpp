@@ -0,0 +1,197 @@
+#include "wal.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+using namespace mdb;
+
+namespace {
+/// numbers of segments in dir in write order.
+std::vector<uint64_t> segmentNumbers(const std::string &dir) {
+  std::vector<uint64_t> result;
+  if (!fs::exists(dir)) {
+    return result;
+  }
+  for (auto p : utils::ls(dir, wal_file_ext)) {
+    try {
+      result.push_back(std::stoull(p.stem().string()));
+    } catch (std::logic_error &) {
+      logger_info("WAL: skip unknown file " << p.string());
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+std::string segmentPath(const std::string &dir, uint64_t number) {
+  std::stringstream ss;
+  ss << std::setw(20) << std::setfill('0') << number << wal_file_ext;
+  return (fs::path(dir) / ss.str()).string();
+}
+}
+
+WAL::WAL(const std::string &dir, uint64_t segment_size)
+    : m_dir(dir), m_segment_size(segment_size), m_file(nullptr),
+      m_current(0), m_current_size(0) {
+  auto numbers = segmentNumbers(m_dir);
+  if (!numbers.empty()) {
+    m_current = numbers.back();
+  }
+  this->openSegment();
+}
+
+WAL::~WAL() { this->close(); }
+
+std::string WAL::segmentName(uint64_t number) const {
+  return segmentPath(m_dir, number);
+}
+
+void WAL::openSegment() {
+  m_current++;
+  m_current_size = 0;
+  auto fname = this->segmentName(m_current);
+  m_file = std::fopen(fname.c_str(), "wb");
+  if (m_file == nullptr) {
+    throw MAKE_EXCEPTION("WAL: can`t create " + fname);
+  }
+  m_pending[m_current] = 0;
+}
+
+uint32_t WAL::checksum(const Meas::PMeas begin, const size_t count) {
+  // FNV-1a
+  uint32_t result = 2166136261u;
+  auto bytes = reinterpret_cast<const unsigned char *>(begin);
+  for (size_t i = 0; i < count * sizeof(Meas); ++i) {
+    result ^= bytes[i];
+    result *= 16777619u;
+  }
+  return result;
+}
+
+void WAL::append(const Meas::PMeas begin, const size_t count, Segments &segments) {
+  if (count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_file == nullptr) {
+    throw MAKE_EXCEPTION("WAL: append to closed log");
+  }
+  if (m_current_size >= m_segment_size) {
+    std::fclose(m_file);
+    auto sealed = m_current;
+    this->openSegment();
+    this->removeIfDone(sealed);
+  }
+
+  RecordHeader hdr;
+  hdr.count = static_cast<uint32_t>(count);
+  hdr.checksum = checksum(begin, count);
+  if ((std::fwrite(&hdr, sizeof(RecordHeader), 1, m_file) != 1) ||
+      (std::fwrite(begin, sizeof(Meas), count, m_file) != count)) {
+    throw MAKE_EXCEPTION("WAL: write error " + this->segmentName(m_current));
+  }
+  // after fflush record survive process crash.
+  std::fflush(m_file);
+  m_current_size += sizeof(RecordHeader) + sizeof(Meas) * count;
+
+  if (segments.empty() || (segments.back() != m_current)) {
+    segments.push_back(m_current);
+    m_pending[m_current]++;
+  }
+}
+
+void WAL::release(const Segments &segments) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  for (auto number : segments) {
+    auto it = m_pending.find(number);
+    if ((it == m_pending.end()) || (it->second == 0)) {
+      continue;
+    }
+    it->second--;
+    this->removeIfDone(number);
+  }
+}
+
+void WAL::removeIfDone(uint64_t number) {
+  auto it = m_pending.find(number);
+  if ((number == m_current) || (it == m_pending.end()) || (it->second != 0)) {
+    return;
+  }
+  m_pending.erase(it);
+  fs::remove(this->segmentName(number));
+}
+
+void WAL::sync() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_file != nullptr) {
+    std::fflush(m_file);
+    utils::sync_file(this->segmentName(m_current));
+  }
+}
+
+void WAL::close() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_file == nullptr) {
+    return;
+  }
+  std::fclose(m_file);
+  m_file = nullptr;
+  if (m_pending[m_current] == 0) {
+    m_pending.erase(m_current);
+    fs::remove(this->segmentName(m_current));
+  }
+}
+
+size_t WAL::segmentsCount() const {
+  return segmentNumbers(m_dir).size();
+}
+
+Meas::MeasList WAL::readAll(const std::string &dir) {
+  Meas::MeasList result;
+  std::vector<Meas> buffer;
+  for (auto number : segmentNumbers(dir)) {
+    auto fname = segmentPath(dir, number);
+    FILE *file = std::fopen(fname.c_str(), "rb");
+    if (file == nullptr) {
+      throw MAKE_EXCEPTION("WAL: can`t open " + fname);
+    }
+    auto file_size = fs::file_size(fname);
+    uint64_t pos = 0;
+    RecordHeader hdr;
+    while (std::fread(&hdr, sizeof(RecordHeader), 1, file) == 1) {
+      pos += sizeof(RecordHeader) + sizeof(Meas) * uint64_t(hdr.count);
+      if (pos > file_size) {
+        logger_info("WAL: truncated record in " << fname);
+        break;
+      }
+      buffer.resize(hdr.count);
+      if ((std::fread(buffer.data(), sizeof(Meas), hdr.count, file) != hdr.count) ||
+          (checksum(buffer.data(), hdr.count) != hdr.checksum)) {
+        logger_info("WAL: broken record in " << fname);
+        break;
+      }
+      result.insert(result.end(), buffer.begin(), buffer.end());
+    }
+    std::fclose(file);
+  }
+  return result;
+}
+
+void WAL::removeAll(const std::string &dir) {
+  for (auto number : segmentNumbers(dir)) {
+    fs::remove(segmentPath(dir, number));
+  }
+}
+
+WALHold::WALHold(WAL *wal, WAL::Segments &&segments)
+    : m_wal(wal), m_segments(std::move(segments)) {}
+
+WALHold::~WALHold() {
+  m_wal->release(m_segments);
+}
@@ -1,40 +1,151 @@
 #include "writewindow.h"
 
+#if defined(_MSC_VER) && !defined(__GNUC__)
+#include <intrin.h>
+#endif
+
 using namespace mdb;
 
-WriteWindow::WriteWindow(const size_t &size): std::vector<mdb::Meas>(size) {
+namespace {
+/// count of set bits.
+size_t popCount(uint64_t value) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return __popcnt64(value);
+#else
+	size_t result = 0;
+	for (; value != 0; value &= value - 1) {
+		result++;
+	}
+	return result;
+#endif
 }
 
-WriteWindow::WriteWindow(const WriteWindow& other) : std::vector<mdb::Meas>(other) {
+/// index of lowest set bit, value is not zero.
+size_t lowestBit(uint64_t value) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long result;
+	_BitScanForward64(&result, value);
+	return result;
+#else
+	size_t result = 0;
+	for (; (value & 1) == 0; value >>= 1) {
+		result++;
+	}
+	return result;
+#endif
 }
 
-WriteWindow::WriteWindow(WriteWindow::const_iterator begin, WriteWindow::const_iterator end) : std::vector<mdb::Meas>(begin,end) {
+/// position of value of bit pos in values of chunk.
+size_t rank(uint64_t mask, size_t pos) {
+	return popCount(mask & ((uint64_t(1) << pos) - 1));
+}
 }
 
-void WriteWindow::operator= (const WriteWindow& other) {
-	if (other.size() == 0){
-		if (this->size() != 0) {
-			this->clear();
+WriteWindow::Chunk::Chunk() : mask(0) {
+}
+
+WriteWindow::const_iterator::const_iterator(Chunks::const_iterator it, Chunks::const_iterator end)
+	: m_it(it), m_end(end), m_pos(0) {
+	skipEmpty();
+}
+
+void WriteWindow::const_iterator::skipEmpty() {
+	while (m_it != m_end) {
+		auto rest = m_pos < chunk_size ? (m_it->second->mask >> m_pos) : 0;
+		if (rest != 0) {
+			m_pos += lowestBit(rest);
+			return;
 		}
-		return;
+		++m_it;
+		m_pos = 0;
+	}
+}
+
+const Meas& WriteWindow::const_iterator::operator*()const {
+	return m_it->second->values[rank(m_it->second->mask, m_pos)];
+}
+
+const Meas* WriteWindow::const_iterator::operator->()const {
+	return &m_it->second->values[rank(m_it->second->mask, m_pos)];
+}
+
+WriteWindow::const_iterator& WriteWindow::const_iterator::operator++() {
+	m_pos++;
+	skipEmpty();
+	return *this;
+}
+
+bool WriteWindow::const_iterator::operator==(const const_iterator&other)const {
+	return (m_it == other.m_it) && (m_it == m_end || m_pos == other.m_pos);
+}
+
+bool WriteWindow::const_iterator::operator!=(const const_iterator&other)const {
+	return !(*this == other);
+}
+
+WriteWindow::WriteWindow() : m_size(0) {
+}
+
+bool WriteWindow::update(const Meas&m) {
+	auto &chunk = m_chunks[m.id / chunk_size];
+	auto pos = m.id % chunk_size;
+	auto bit = uint64_t(1) << pos;
+	if (chunk == nullptr) {
+		chunk = std::make_shared<Chunk>();
 	}
-	clear();
-	resize(other.size());
-    for (size_t i = 0; i < other.size(); i++) {
-		this->at(i) = other[i];
+	auto index = rank(chunk->mask, pos);
+	if ((chunk->mask & bit) && (chunk->values[index].time >= m.time)) {
+		return false;
 	}
+	// chunk is shared with copy of window.
+	if (!chunk.unique()) {
+		chunk = std::make_shared<Chunk>(*chunk);
+	}
+	if ((chunk->mask & bit) == 0) {
+		chunk->mask |= bit;
+		chunk->values.insert(chunk->values.begin() + index, m);
+		m_size++;
+	} else {
+		chunk->values[index] = m;
+	}
+	return true;
 }
 
-Meas WriteWindow::operator[](const size_t pos)const {
-	if (size() <= pos) {
+Meas WriteWindow::get(const Id id)const {
+	auto it = m_chunks.find(id / chunk_size);
+	auto pos = id % chunk_size;
+	if ((it == m_chunks.end()) || ((it->second->mask & (uint64_t(1) << pos)) == 0)) {
 		return Meas::empty();
 	}
-	return this->at(pos);
+	return it->second->values[rank(it->second->mask, pos)];
 }
 
-Meas&WriteWindow::operator[](const size_t pos) {
-	if (size() <= pos) {
-		this->resize(pos + 1);
-	}
-	return this->at(pos);
+bool WriteWindow::contains(const Id id)const {
+	auto it = m_chunks.find(id / chunk_size);
+	return (it != m_chunks.end()) && ((it->second->mask & (uint64_t(1) << (id % chunk_size))) != 0);
+}
+
+size_t WriteWindow::size()const {
+	return m_size;
+}
+
+bool WriteWindow::empty()const {
+	return m_size == 0;
+}
+
+void WriteWindow::clear() {
+	m_chunks.clear();
+	m_size = 0;
+}
+
+WriteWindow::const_iterator WriteWindow::begin()const {
+	return const_iterator(m_chunks.begin(), m_chunks.end());
+}
+
+WriteWindow::const_iterator WriteWindow::end()const {
+	return const_iterator(m_chunks.end(), m_chunks.end());
 }
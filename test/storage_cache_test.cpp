@@ -7,10 +7,14 @@
 #include <meas.h>
 #include <utils.h>
 #include <cache.h>
+#include <kernels.h>
+#include <time_utils.h>
 #include <logger.h>
 
 #include <iterator>
 #include <list>
+#include <thread>
+#include <chrono>
 using namespace mdb;
 
 BOOST_AUTO_TEST_CASE(CacheIO) {
@@ -79,17 +83,211 @@ BOOST_AUTO_TEST_CASE(CacheResize) {
 }
 
 BOOST_AUTO_TEST_CASE(CachePoolChecks) {
-  mdb::CachePool pool(2, 100);
+  auto pool = std::make_shared<mdb::CachePool>(2, 100);
 
-  BOOST_CHECK(pool.haveCache());
+  BOOST_CHECK(pool->haveCache());
 
-  auto c1 = pool.getCache();
+  auto c1 = pool->getCache();
   c1->sync_begin();
-  auto c2 = pool.getCache();
+  auto c2 = pool->getCache();
   c2->sync_begin();
 
-  BOOST_CHECK(!pool.haveCache());
+  BOOST_CHECK(!pool->haveCache());
   c1->sync_complete();
 
-  BOOST_CHECK(pool.haveCache());
+  BOOST_CHECK(pool->haveCache());
+
+  // cache, released after pool destroyed, is not returned to it.
+  pool = nullptr;
+  c2->sync_complete();
+}
+
+BOOST_AUTO_TEST_CASE(CachePoolPolicies) {
+  {
+    auto pool = std::make_shared<mdb::CachePool>(1, 10);
+    pool->setPolicy(mdb::PoolPolicy::Drop);
+    auto c1 = pool->getCache();
+    BOOST_CHECK(c1 != nullptr);
+    BOOST_CHECK(pool->getCache() == nullptr);
+    BOOST_CHECK(pool->tryGetCache() == nullptr);
+    c1->sync_begin();
+    c1->sync_complete();
+    BOOST_CHECK(pool->tryGetCache() == c1);
+  }
+  {
+    auto pool = std::make_shared<mdb::CachePool>(1, 10);
+    pool->setPolicy(mdb::PoolPolicy::Grow, sizeof(mdb::Meas) * 10 * 2);
+    auto c1 = pool->getCache();
+    auto c2 = pool->getCache();
+    BOOST_CHECK(c1 != nullptr);
+    BOOST_CHECK(c2 != nullptr);
+    BOOST_CHECK(c1 != c2);
+    BOOST_CHECK(!pool->haveCache());
+    BOOST_CHECK(pool->tryGetCache() == nullptr);
+  }
+  {
+    auto pool = std::make_shared<mdb::CachePool>(1, 10);
+    auto c1 = pool->getCache();
+    c1->append(mdb::Meas::empty(), 0);
+    c1->sync_begin();
+    std::thread releaser([c1]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      c1->sync_complete();
+    });
+    auto c2 = pool->getCache();
+    releaser.join();
+    BOOST_CHECK(c2 == c1);
+    BOOST_CHECK_EQUAL(c2->size(), size_t(0));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(KernelFilterPastTime) {
+  const size_t count = 1003;
+  const mdb::Time cur_time = 100000;
+  const mdb::Time past_time = 500;
+  std::vector<mdb::Meas> src(count);
+  for (size_t i = 0; i < count; ++i) {
+    src[i].id = i;
+    // old, fresh and from future values mixed.
+    src[i].time = cur_time - 1000 + (i * 7919) % 2000;
+  }
+  std::vector<mdb::Meas> expected;
+  for (auto m : src) {
+    if (mdb::checkPastTime(m.time, past_time, cur_time)) {
+      expected.push_back(m);
+    }
+  }
+  std::vector<mdb::Meas> scalar(count), fast(count);
+  auto scalar_count = mdb::kernels::filterPastTimeScalar(src.data(), count, cur_time, past_time, scalar.data());
+  auto fast_count = mdb::kernels::filterPastTime(src.data(), count, cur_time, past_time, fast.data());
+  BOOST_CHECK_EQUAL(scalar_count, expected.size());
+  BOOST_CHECK_EQUAL(fast_count, expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(scalar[i].id, expected[i].id);
+    BOOST_CHECK_EQUAL(fast[i].id, expected[i].id);
+  }
+
+  // cache reads clock itself.
+  auto now = mdb::TimeWork::CurrentUtcTime();
+  auto minute = mdb::TimeWork::fromDuration(std::chrono::minutes(1));
+  for (size_t i = 0; i < count; ++i) {
+    src[i].time = (i % 2 == 0) ? now : now - 2 * minute;
+  }
+  mdb::Cache c(count);
+  auto res = c.append(src.data(), count, minute);
+  BOOST_CHECK_EQUAL(res.writed, count);
+  BOOST_CHECK_EQUAL(res.ignored, count / 2);
+  BOOST_CHECK_EQUAL(c.size(), count - count / 2);
+  for (size_t i = 0; i < c.size(); ++i) {
+    BOOST_CHECK_EQUAL(c.asArray()[i].id, mdb::Id(i * 2));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CurValuesCacheTable) {
+  // 16 slots, table doubled when 12 of them used.
+  mdb::CurValuesCache c(16);
+  const size_t ids_count = 100;
+  IdArray ids;
+  for (size_t i = 0; i < ids_count; ++i) {
+    ids.push_back(i);
+    auto m = mdb::Meas::empty();
+    m.id = i;
+    m.time = 10;
+    m.value = 1;
+    c.writeValue(m);
+    // older value ignored, newer replace.
+    m.time = 5;
+    m.value = 2;
+    c.writeValue(m);
+    m.time = 11;
+    m.value = 3;
+    c.writeValue(m);
+  }
+  BOOST_CHECK_EQUAL(c.size(), ids_count);
+  BOOST_CHECK_EQUAL(c.capacity(), size_t(256));
+  ids.push_back(ids_count + 1);
+  auto values = c.readValue(ids);
+  BOOST_CHECK_EQUAL(values.size(), ids.size());
+  size_t pos = 0;
+  for (auto v : values) {
+    if (pos == ids_count) {
+      BOOST_CHECK_EQUAL(v.time, mdb::Time(0));
+      break;
+    }
+    BOOST_CHECK_EQUAL(v.id, ids[pos]);
+    BOOST_CHECK_EQUAL(v.time, mdb::Time(11));
+    BOOST_CHECK_EQUAL(v.value, mdb::Value(3));
+    pos++;
+  }
+
+  // readers never see torn values.
+  mdb::CurValuesCache shared;
+  const size_t writers_count = 2;
+  const mdb::Time max_time = 20000;
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> torn{0};
+  std::vector<std::thread> writers;
+  for (size_t w = 0; w < writers_count; ++w) {
+    writers.emplace_back([&shared, max_time]() {
+      for (mdb::Time t = 1; t < max_time; ++t) {
+        auto m = mdb::Meas::empty();
+        m.id = t % 64;
+        m.time = t;
+        m.value = t;
+        m.flag = t;
+        shared.writeValue(m);
+      }
+    });
+  }
+  std::thread reader([&shared, &stop, &torn]() {
+    IdArray query;
+    for (mdb::Id i = 0; i < 64; ++i) {
+      query.push_back(i);
+    }
+    while (!stop) {
+      for (auto v : shared.readValue(query)) {
+        if ((v.value != v.time) || (v.flag != v.time)) {
+          torn++;
+        }
+      }
+    }
+  });
+  for (auto &t : writers) {
+    t.join();
+  }
+  stop = true;
+  reader.join();
+  BOOST_CHECK_EQUAL(torn.load(), size_t(0));
+  IdArray last{(max_time - 1) % 64};
+  BOOST_CHECK_EQUAL(shared.readValue(last).front().time, max_time - 1);
+
+  // values written while table grows are not lost.
+  mdb::CurValuesCache growing(16);
+  const size_t grow_ids = 10000;
+  writers.clear();
+  for (size_t w = 0; w < writers_count; ++w) {
+    writers.emplace_back([&growing, w, writers_count, grow_ids]() {
+      for (mdb::Id i = w; i < grow_ids; i += writers_count) {
+        auto m = mdb::Meas::empty();
+        m.id = i;
+        m.time = i + 1;
+        growing.writeValue(m);
+      }
+    });
+  }
+  for (auto &t : writers) {
+    t.join();
+  }
+  BOOST_CHECK_EQUAL(growing.size(), grow_ids);
+  IdArray all;
+  for (mdb::Id i = 0; i < grow_ids; ++i) {
+    all.push_back(i);
+  }
+  size_t lost = 0;
+  for (auto v : growing.readValue(all)) {
+    if (v.time != v.id + 1) {
+      lost++;
+    }
+  }
+  BOOST_CHECK_EQUAL(lost, size_t(0));
 }
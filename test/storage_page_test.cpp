@@ -5,14 +5,19 @@
 #include "test_common.h"
 #include <meas.h>
 #include <page.h>
+#include <id_filter.h>
+#include <kernels.h>
+#include <postings.h>
 #include <storage.h>
 #include <logger.h>
 #include <utils.h>
 #include <exception.h>
 
 #include <iterator>
+#include <fstream>
 #include <list>
 using namespace mdb;
+namespace fs = boost::filesystem;
 
 BOOST_AUTO_TEST_CASE(PageCreateOpen) {
   {
@@ -218,3 +223,447 @@ BOOST_AUTO_TEST_CASE(PagereadIntervalFltr) {
   utils::rm(mdb_test::test_page_name);
   utils::rm(index);
 }
+
+BOOST_AUTO_TEST_CASE(IndexBlocks) {
+  const std::string index_name = mdb_test::test_page_name + "i";
+  utils::rm(index_name);
+  const size_t meas_count = mdb::index_block_size * 2 + 10;
+  {
+    mdb::Index index;
+    index.setFileName(index_name);
+    for (size_t i = 0; i < 10; ++i) {
+      auto m = mdb::Meas::empty();
+      m.id = i;
+      m.time = i;
+      index.append(m, i);
+    }
+    // records are buffered until flush
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(index_name), sizeof(mdb::Index::IndexHeader));
+    index.flush();
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(index_name),
+                      sizeof(mdb::Index::IndexHeader) + sizeof(mdb::Index::IndexRecord));
+
+    std::vector<mdb::Meas> values(meas_count - 10);
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i].id = i + 10;
+      values[i].time = meas_count - i;
+    }
+    index.append(values.data(), values.size(), 10);
+    index.flush();
+    BOOST_CHECK_EQUAL(index.size(), size_t(3));
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(index_name),
+                      sizeof(mdb::Index::IndexHeader) + 3 * sizeof(mdb::Index::IndexRecord));
+
+    auto found = index.findInIndex(mdb::IdArray{}, 2, 4);
+    BOOST_CHECK_EQUAL(found.size(), size_t(1));
+    BOOST_CHECK_EQUAL(found.front().pos, uint64_t(0));
+    BOOST_CHECK_EQUAL(found.front().count, mdb::index_block_size);
+
+    found = index.findInIndex(mdb::IdArray{meas_count - 1}, 0, meas_count);
+    BOOST_CHECK_EQUAL(found.size(), size_t(1));
+    BOOST_CHECK_EQUAL(found.front().pos, 2 * mdb::index_block_size);
+    BOOST_CHECK_EQUAL(found.front().count, uint64_t(10));
+  }
+  {
+    mdb::Index index;
+    index.setFileName(index_name);
+    BOOST_CHECK_EQUAL(index.size(), size_t(3));
+    auto m = mdb::Meas::empty();
+    index.append(m, meas_count);
+    BOOST_CHECK_EQUAL(index.size(), size_t(3));
+  }
+  utils::rm(index_name);
+}
+
+BOOST_AUTO_TEST_CASE(PageWriteWindowIncremental) {
+  const std::string ww_name = mdb_test::test_page_name + "w";
+  const size_t ids_count = 10;
+  {
+    auto page = Page::Create(mdb_test::test_page_name, mdb_test::sizeInMb10);
+    for (size_t i = 0; i < ids_count; ++i) {
+      auto m = Meas::empty();
+      m.id = i;
+      m.time = i;
+      page->append(m);
+    }
+    page->flush();
+    // file is allocated for min capacity, not rewritten on each flush.
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(ww_name),
+                      Page::ww_min_capacity * sizeof(Meas));
+
+    auto m = Meas::empty();
+    m.id = 3;
+    m.time = 100;
+    page->append(m);
+    // older value not change window.
+    m.id = 4;
+    m.time = 0;
+    page->append(m);
+    page->close();
+  }
+  {
+    auto page = Page::Open(mdb_test::test_page_name);
+    auto ww = page->getWriteWindow();
+    BOOST_CHECK_EQUAL(ww->size(), ids_count);
+    for (size_t i = 0; i < ids_count; ++i) {
+      BOOST_CHECK_EQUAL(ww->get(i).id, i);
+      BOOST_CHECK_EQUAL(ww->get(i).time, i == 3 ? Time(100) : Time(i));
+    }
+    page->close();
+  }
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(mdb_test::test_page_name + "i");
+  utils::rm(ww_name);
+}
+
+BOOST_AUTO_TEST_CASE(PageWriteWindowSparse) {
+  const std::string ww_name = mdb_test::test_page_name + "w";
+  const Id big_id = 4000000000ull;
+  {
+    auto page = Page::Create(mdb_test::test_page_name, mdb_test::sizeInMb10);
+    auto m = Meas::empty();
+    m.id = big_id;
+    m.time = 1;
+    page->append(m);
+    m.id = 1;
+    page->append(m);
+
+    auto snapshot = page->getWriteWindow();
+    BOOST_CHECK_EQUAL(snapshot->size(), size_t(2));
+    // not changed window shares snapshot.
+    BOOST_CHECK(snapshot == page->getWriteWindow());
+
+    m.id = big_id;
+    m.time = 2;
+    page->append(m);
+    auto changed = page->getWriteWindow();
+    BOOST_CHECK(snapshot != changed);
+    BOOST_CHECK_EQUAL(snapshot->get(big_id).time, Time(1));
+    BOOST_CHECK_EQUAL(changed->get(big_id).time, Time(2));
+    BOOST_CHECK(!changed->contains(2));
+    // ids of one chunk stored in order of id.
+    WriteWindow window;
+    for (auto id : {Id(5), Id(63), Id(0), Id(7)}) {
+      auto v = Meas::empty();
+      v.id = id;
+      v.time = id + 1;
+      BOOST_CHECK(window.update(v));
+    }
+    BOOST_CHECK_EQUAL(window.get(7).time, Time(8));
+    BOOST_CHECK_EQUAL(window.get(0).time, Time(1));
+    BOOST_CHECK(!window.contains(6));
+    std::vector<Id> chunk_ids;
+    for (auto v : window) {
+      chunk_ids.push_back(v.id);
+    }
+    BOOST_CHECK((chunk_ids == std::vector<Id>{0, 5, 7, 63}));
+
+    std::vector<Id> ids;
+    for (auto v : *changed) {
+      ids.push_back(v.id);
+    }
+    BOOST_CHECK_EQUAL(ids.size(), size_t(2));
+    BOOST_CHECK_EQUAL(ids.front(), Id(1));
+    BOOST_CHECK_EQUAL(ids.back(), big_id);
+    page->close();
+    // file size depends on count of ids, not on max id.
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(ww_name),
+                      Page::ww_min_capacity * sizeof(Meas));
+  }
+  {
+    auto page = Page::Open(mdb_test::test_page_name);
+    auto ww = page->getWriteWindow();
+    BOOST_CHECK_EQUAL(ww->size(), size_t(2));
+    BOOST_CHECK_EQUAL(ww->get(big_id).time, Time(2));
+    page->close();
+  }
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(mdb_test::test_page_name + "i");
+  utils::rm(ww_name);
+}
+
+BOOST_AUTO_TEST_CASE(PageReadIntervalSorted) {
+  const size_t TestableMeasCount = 1000;
+  for (auto sorted : {true, false}) {
+    auto page = Page::Create(mdb_test::test_page_name, mdb_test::sizeInMb10);
+    for (size_t i = 0; i < TestableMeasCount; ++i) {
+      auto m = mdb::Meas::empty();
+      m.id = i % 10;
+      m.time = i / 2;
+      // one value out of order
+      if (!sorted && (i == TestableMeasCount / 2)) {
+        m.time = 0;
+      }
+      page->append(m);
+    }
+    BOOST_CHECK_EQUAL(page->getHeader().timeSorted, sorted);
+
+    Meas::MeasList readRes;
+    page->readInterval(100, 200)->readAll(&readRes);
+    size_t in_interval = 0;
+    for (auto m : readRes) {
+      if (utils::inInterval(Time(100), Time(200), m.time)) {
+        in_interval++;
+      }
+    }
+    BOOST_CHECK_EQUAL(in_interval, size_t(202));
+
+    readRes.clear();
+    page->readInterval(IdArray{1}, 0, 0, 100, 200)->readAll(&readRes);
+    in_interval = 0;
+    for (auto m : readRes) {
+      BOOST_CHECK_EQUAL(m.id, Id(1));
+      if (utils::inInterval(Time(100), Time(200), m.time)) {
+        in_interval++;
+      }
+    }
+    BOOST_CHECK_EQUAL(in_interval, size_t(21));
+    page->close();
+    utils::rm(mdb_test::test_page_name);
+    utils::rm(mdb_test::test_page_name + "i");
+    utils::rm(mdb_test::test_page_name + "w");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(IndexCacheShared) {
+  const size_t meas_count = mdb::index_block_size * 3;
+  const std::string index_name = mdb_test::test_page_name + "i";
+  IndexCache::get()->clear();
+  {
+    auto page = Page::Create(mdb_test::test_page_name, sizeof(Page::Header) + sizeof(Meas) * meas_count);
+    std::vector<Meas> values(meas_count);
+    for (size_t i = 0; i < meas_count; ++i) {
+      values[i].id = i;
+      // second block is older than first.
+      auto block = i / mdb::index_block_size;
+      values[i].time = (block == 1 ? 0 : block * mdb::index_block_size) + i % mdb::index_block_size;
+    }
+    BOOST_CHECK_EQUAL(page->append(values.data(), values.size()), meas_count);
+    BOOST_CHECK(page->isFull());
+    page->close();
+  }
+  auto not_shared = Index::ReadBlocks(index_name);
+  BOOST_CHECK_EQUAL(not_shared->records.size(), size_t(3));
+  BOOST_CHECK_EQUAL(not_shared->maxTimePrefix[1], not_shared->records[0].maxTime);
+  BOOST_CHECK_EQUAL(not_shared->minTimeSuffix[0], Time(0));
+  for (int i = 0; i < 2; ++i) {
+    auto page = Page::Open(mdb_test::test_page_name, true);
+    Meas::MeasList values;
+    page->readInterval(10, 20)->readAll(&values);
+    size_t in_interval = 0;
+    for (auto m : values) {
+      if (utils::inInterval(Time(10), Time(20), m.time)) {
+        in_interval++;
+      }
+    }
+    // from first and second blocks.
+    BOOST_CHECK_EQUAL(in_interval, size_t(22));
+    // reader close page.
+    values.clear();
+    page = Page::Open(mdb_test::test_page_name, true);
+    page->readInterval(2 * mdb::index_block_size, 3 * mdb::index_block_size)->readAll(&values);
+    BOOST_CHECK(values.size() >= mdb::index_block_size);
+  }
+  BOOST_CHECK_EQUAL(IndexCache::get()->size(), size_t(1));
+  // recreated page not use old blocks.
+  Page::Create(mdb_test::test_page_name, mdb_test::sizeInMb10)->close();
+  BOOST_CHECK_EQUAL(IndexCache::get()->size(), size_t(0));
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(index_name);
+  utils::rm(mdb_test::test_page_name + "w");
+}
+
+BOOST_AUTO_TEST_CASE(IndexCacheNotFlushed) {
+  const size_t meas_count = mdb::index_block_size * 3;
+  IndexCache::get()->clear();
+  auto writer = Page::Create(mdb_test::test_page_name, sizeof(Page::Header) + sizeof(Meas) * meas_count);
+  std::vector<Meas> values(meas_count);
+  for (size_t i = 0; i < meas_count; ++i) {
+    values[i].id = i;
+    values[i].time = i;
+  }
+  // first blocks flushed, last are in buffer of writer.
+  writer->append(values.data(), mdb::index_block_size);
+  writer->flush();
+  writer->append(values.data() + mdb::index_block_size, meas_count - mdb::index_block_size);
+  BOOST_CHECK(writer->isFull());
+  {
+    auto page = Page::Open(mdb_test::test_page_name, true);
+    Meas::MeasList readed;
+    page->readInterval(2 * mdb::index_block_size, 3 * mdb::index_block_size)->readAll(&readed);
+  }
+  // truncated index is not shared.
+  BOOST_CHECK_EQUAL(IndexCache::get()->size(), size_t(0));
+  writer->close();
+  {
+    auto page = Page::Open(mdb_test::test_page_name, true);
+    Meas::MeasList readed;
+    page->readInterval(2 * mdb::index_block_size, 3 * mdb::index_block_size)->readAll(&readed);
+    BOOST_CHECK(readed.size() >= mdb::index_block_size);
+  }
+  BOOST_CHECK_EQUAL(IndexCache::get()->size(), size_t(1));
+  IndexCache::get()->clear();
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(mdb_test::test_page_name + "i");
+  utils::rm(mdb_test::test_page_name + "w");
+}
+
+BOOST_AUTO_TEST_CASE(PageVersionCheck) {
+  Page::Create(mdb_test::test_page_name, mdb_test::sizeInMb10)->close();
+  {
+    // page of old format.
+    std::fstream f(mdb_test::test_page_name, std::ios::in | std::ios::out | std::ios::binary);
+    char version = 1;
+    f.write(&version, 1);
+  }
+  BOOST_CHECK_THROW(Page::Open(mdb_test::test_page_name), std::exception);
+  BOOST_CHECK_THROW(Page::Open(mdb_test::test_page_name, true), std::exception);
+  BOOST_CHECK_THROW(Page::ReadHeader(mdb_test::test_page_name), std::exception);
+  {
+    std::fstream f(mdb_test::test_page_name + "i", std::ios::in | std::ios::out | std::ios::binary);
+    uint16_t format = 1;
+    f.write(reinterpret_cast<char *>(&format), sizeof(format));
+  }
+  BOOST_CHECK_THROW(Index::ReadBlocks(mdb_test::test_page_name + "i"), std::exception);
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(mdb_test::test_page_name + "i");
+  utils::rm(mdb_test::test_page_name + "w");
+}
+
+BOOST_AUTO_TEST_CASE(IdFilterKinds) {
+  IdFilter all;
+  BOOST_CHECK(all.empty());
+  BOOST_CHECK(all.contains(12345));
+
+  IdFilter dense(IdArray{ 100, 101, 164, 300 });
+  BOOST_CHECK(dense.isBitmap());
+  BOOST_CHECK(dense.contains(100) && dense.contains(164) && dense.contains(300));
+  BOOST_CHECK(!dense.contains(0) && !dense.contains(99) && !dense.contains(102) && !dense.contains(301));
+
+  IdFilter sparse(IdArray{ 5, 1ull << 40, 1ull << 63 });
+  BOOST_CHECK(!sparse.empty());
+  BOOST_CHECK(!sparse.isBitmap());
+  BOOST_CHECK(sparse.contains(5) && sparse.contains(1ull << 40) && sparse.contains(1ull << 63));
+  BOOST_CHECK(!sparse.contains(6) && !sparse.contains(0));
+
+  BOOST_CHECK_EQUAL(IdFilter::make(IdArray{}).get(), IdFilter::all().get());
+  BOOST_CHECK(IdFilter::make(IdArray{ 7 })->contains(7));
+}
+
+BOOST_AUTO_TEST_CASE(PageScanKernel) {
+  const uint32_t count = 1003;
+  // half of times above 2^63: compares must be unsigned.
+  const Time high = Time(1) << 63;
+  std::vector<Meas> src(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    src[i].id = i % 13;
+    src[i].time = (i % 2 ? high : 0) + (i * 7919) % 500;
+    src[i].source = i % 3;
+    src[i].flag = i % 5;
+  }
+  IdFilter ids(IdArray{ 1, 4, 12 });
+  kernels::ScanFilter filters[6];
+  filters[0].from = 100;
+  filters[0].to = 300;
+  filters[1].checkTime = false;
+  filters[1].source = 2;
+  filters[2].from = 0;
+  filters[2].to = 450;
+  filters[2].flag = 3;
+  filters[2].ids = &ids;
+  filters[3].from = 100;
+  filters[3].to = 400;
+  filters[3].source = 1;
+  filters[3].flag = 1;
+  filters[3].ids = &ids;
+  filters[4].from = high + 100;
+  filters[4].to = high + 300;
+  filters[5].from = 400;
+  filters[5].to = high + 100;
+  filters[5].ids = &ids;
+
+  typedef size_t (*scan_fn)(const Meas *, uint32_t, const kernels::ScanFilter &, uint32_t *);
+  std::vector<scan_fn> variants{ &kernels::scanScalar, &kernels::scan };
+  if (kernels::haveAVX2()) {
+    variants.push_back(&kernels::scanAVX2);
+  }
+  if (kernels::haveAVX512()) {
+    variants.push_back(&kernels::scanAVX512);
+  }
+  for (auto &filter : filters) {
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < count; ++i) {
+      auto m = src[i];
+      if ((!filter.checkTime || utils::inInterval(filter.from, filter.to, m.time)) &&
+          (filter.source == 0 || m.source == filter.source) && (filter.flag == 0 || m.flag == filter.flag) &&
+          (filter.ids == nullptr || filter.ids->contains(m.id))) {
+        expected.push_back(i);
+      }
+    }
+    BOOST_CHECK(!expected.empty());
+    for (auto variant : variants) {
+      std::vector<uint32_t> sel(count);
+      auto sel_count = variant(src.data(), count, filter, sel.data());
+      BOOST_CHECK_EQUAL(sel_count, expected.size());
+      BOOST_CHECK(std::equal(expected.begin(), expected.end(), sel.begin()));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PagePostingsRead) {
+  const size_t meas_count = 100;
+  const std::string postings_name = mdb_test::test_page_name + "p";
+  std::vector<Meas> values(meas_count);
+  {
+    auto page = Page::Create(mdb_test::test_page_name, sizeof(Page::Header) + sizeof(Meas) * meas_count);
+    for (size_t i = 0; i < meas_count; ++i) {
+      values[i].id = i % 10;
+      values[i].time = i;
+    }
+    page->append(values.data(), values.size());
+    BOOST_CHECK(page->isFull());
+    page->close();
+  }
+  auto read_id3 = []() {
+    auto page = Page::Open(mdb_test::test_page_name, true);
+    Meas::MeasList result;
+    page->readInterval(IdArray{ 3 }, 0, 0, 0, meas_count)->readAll(&result);
+    for (auto m : result) {
+      BOOST_CHECK_EQUAL(m.id, Id(3));
+    }
+    return result.size();
+  };
+  // without postings page is scanned.
+  BOOST_CHECK_EQUAL(read_id3(), meas_count / 10);
+  {
+    // readers of page share filter of query.
+    auto filter = IdFilter::make(IdArray{ 3 });
+    auto interval = Page::Open(mdb_test::test_page_name, true)->readInterval(IdArray{ 3 }, 0, 0, 0, meas_count, filter);
+    auto point = Page::Open(mdb_test::test_page_name, true)->readInTimePoint(IdArray{ 3 }, 0, 0, meas_count / 2, filter);
+    BOOST_CHECK_EQUAL(interval->id_filter.get(), filter.get());
+    BOOST_CHECK_EQUAL(point->id_filter.get(), filter.get());
+    Meas::MeasList result;
+    point->readAll(&result);
+    BOOST_CHECK_EQUAL(result.size(), size_t(1));
+    BOOST_CHECK_EQUAL(result.front().id, Id(3));
+  }
+
+  // postings, where id 3 has only first value, show that reader uses them.
+  auto postings_values = values;
+  for (size_t i = 10; i < meas_count; ++i) {
+    postings_values[i].id = 0;
+  }
+  Postings::Build(postings_name, postings_values.data(), postings_values.size());
+  BOOST_CHECK(!fs::exists(postings_name + ".tmp"));
+  BOOST_CHECK_EQUAL(read_id3(), size_t(1));
+
+  // truncated postings are not readed out of data.
+  IndexCache::get()->clear();
+  fs::resize_file(postings_name, fs::file_size(postings_name) - 1);
+  BOOST_CHECK_THROW(Postings::Load(postings_name)->positions(IdArray{ 9 }), std::exception);
+
+  IndexCache::get()->clear();
+  utils::rm(mdb_test::test_page_name);
+  utils::rm(mdb_test::test_page_name + "i");
+  utils::rm(postings_name);
+}
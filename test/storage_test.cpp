@@ -5,10 +5,14 @@
 #include "test_common.h"
 #include <page.h>
 #include <storage.h>
+#include <page_manager.h>
+#include <importer.h>
+#include <postings.h>
 #include <time_utils.h>
 #include <logger.h>
 #include <utils.h>
 
+#include <algorithm>
 #include <iterator>
 #include <list>
 #include <iostream>
@@ -164,8 +168,9 @@ BOOST_AUTO_TEST_CASE(StorageIO) {
 
       meases.erase(std::remove_if(meases.begin(), meases.end(), [queryFrom2](const mdb::Meas&m){return m.time > queryFrom2; }), meases.end());
 	  
-      BOOST_CHECK_EQUAL(meases.size(), size_t(1));
+      BOOST_CHECK_EQUAL(meases.size(), size_t(2));
       BOOST_CHECK_EQUAL(meases.front().id, mdb::Id(1));
+      BOOST_CHECK_EQUAL(meases.back().id, mdb::Id(2));
 
 	  ds->Close();
 	  utils::rm(storage_path);
@@ -381,3 +386,625 @@ BOOST_AUTO_TEST_CASE(StorageReadTwoTimesParallel) {
     }
     utils::rm(storage_path);
 }
+
+BOOST_AUTO_TEST_CASE(StorageDurability) {
+  const int meas2write = 10;
+  const size_t write_iteration = 10;
+  const uint64_t storage_size =
+      sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageSync";
+
+  for (auto mode : {mdb::Durability::None, mdb::Durability::Periodic, mdb::Durability::GroupCommit}) {
+    {
+      mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+      ds->setDurability(mode, 10);
+      BOOST_CHECK(ds->durability() == mode);
+
+      size_t arr_size = meas2write * write_iteration;
+      std::vector<mdb::Meas> array(arr_size);
+      for (size_t i = 0; i < arr_size; ++i) {
+        array[i].id = i;
+        array[i].time = i;
+      }
+      ds->append(array.data(), arr_size);
+      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+      ds->sync();
+      ds->Close();
+    }
+    {
+      mdb::Storage::Storage_ptr ds = mdb::Storage::Open(storage_path);
+      Meas::MeasList interval{};
+      auto reader = ds->readInterval(0, meas2write * write_iteration);
+      reader->readAll(&interval);
+      BOOST_CHECK_EQUAL(interval.size(), meas2write * write_iteration);
+      ds->Close();
+    }
+    utils::rm(storage_path);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(StorageWalReplay) {
+  const size_t arr_size = 100;
+  const std::string storage_path = mdb_test::storage_path + "storageWal";
+  const std::string crashed_path = mdb_test::storage_path + "storageWalCrashed";
+  const std::string wal_copy = mdb_test::storage_path + "storageWalCopy";
+
+  std::vector<mdb::Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i;
+    array[i].time = i;
+  }
+  utils::rm(wal_copy);
+  boost::filesystem::create_directory(wal_copy);
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path);
+    ds->setCacheSize(arr_size * 10);
+    ds->enableWal(true, sizeof(mdb::Meas) * 10);
+    BOOST_CHECK(ds->walEnabled());
+    for (size_t i = 0; i < arr_size / 10; ++i) {
+      ds->append(array.data() + i * 10, 10);
+    }
+    // values are in cache only, log is state after crash.
+    auto segments = utils::ls(storage_path, mdb::wal_file_ext);
+    BOOST_CHECK(segments.size() > size_t(1));
+    for (auto p : segments) {
+      boost::filesystem::copy_file(p, boost::filesystem::path(wal_copy) / p.filename());
+    }
+    ds->Close();
+    // all values on page, log removed.
+    BOOST_CHECK_EQUAL(utils::ls(storage_path, mdb::wal_file_ext).size(), size_t(0));
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(crashed_path);
+    ds->Close();
+  }
+  // last record torn by crash.
+  auto segments = utils::ls(wal_copy, mdb::wal_file_ext);
+  segments.sort();
+  {
+    FILE *f = std::fopen(segments.back().string().c_str(), "ab");
+    mdb::WAL::RecordHeader hdr{10, 0};
+    std::fwrite(&hdr, sizeof(hdr), 1, f);
+    std::fwrite(array.data(), sizeof(mdb::Meas), 3, f);
+    std::fclose(f);
+  }
+  for (auto p : segments) {
+    boost::filesystem::copy_file(p, boost::filesystem::path(crashed_path) / p.filename());
+  }
+  BOOST_CHECK_EQUAL(mdb::WAL::readAll(crashed_path).size(), arr_size);
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Open(crashed_path);
+    BOOST_CHECK_EQUAL(utils::ls(crashed_path, mdb::wal_file_ext).size(), size_t(0));
+    // replayed values synced before log removed.
+    BOOST_CHECK(ds->syncedPagesCount() != 0);
+    Meas::MeasList interval{};
+    auto reader = ds->readInterval(0, arr_size);
+    reader->readAll(&interval);
+    BOOST_CHECK_EQUAL(interval.size(), arr_size);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+  utils::rm(crashed_path);
+  utils::rm(wal_copy);
+}
+
+BOOST_AUTO_TEST_CASE(StorageWriterLanes) {
+  const size_t lanes = 3;
+  const size_t meas2write = 10;
+  const size_t arr_size = 300;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageLanes";
+
+  std::vector<mdb::Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % 10;
+    array[i].time = i;
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setWriterLanes(lanes);
+    BOOST_CHECK_EQUAL(ds->writerLanes(), lanes);
+    ds->append(array.data(), arr_size / 2);
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size / 2);
+
+    // each page contain ids of its lane only.
+    for (auto p : utils::ls(storage_path, ".page")) {
+      auto hdr = mdb::Page::Header(mdb::Page::ReadHeader(p.string()));
+      if (!hdr.minMaxInit) {
+        continue;
+      }
+      BOOST_CHECK_EQUAL(hdr.lanes, lanes);
+      BOOST_CHECK_EQUAL(mdb::Page::laneOf(hdr.minId, lanes), hdr.lane);
+      BOOST_CHECK_EQUAL(mdb::Page::laneOf(hdr.maxId, lanes), hdr.lane);
+    }
+    ds->Close();
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Open(storage_path);
+    BOOST_CHECK_EQUAL(ds->writerLanes(), lanes);
+    ds->append(array.data() + arr_size / 2, arr_size / 2);
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+
+    Meas::MeasList one_id{};
+    ds->readInterval(IdArray{ 4 }, 0, 0, 0, arr_size)->readAll(&one_id);
+    BOOST_CHECK_EQUAL(one_id.size(), arr_size / 10);
+    for (auto m : one_id) {
+      BOOST_CHECK_EQUAL(m.id, mdb::Id(4));
+    }
+
+    Meas::MeasList tp{};
+    ds->readInTimePoint(arr_size / 2)->readAll(&tp);
+    BOOST_CHECK_EQUAL(tp.size(), size_t(10));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageTimeOrdered) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 200;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageOrdered";
+
+  // values late at most on 15 positions.
+  std::vector<mdb::Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % 7;
+    array[i].time = i;
+  }
+  for (size_t i = 0; i + 15 < arr_size; i += 16) {
+    std::reverse(array.begin() + i, array.begin() + i + 15);
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setCacheSize(meas2write);
+    ds->setTimeOrdered(true, 20);
+    BOOST_CHECK(ds->timeOrdered());
+    for (size_t i = 0; i < arr_size; i += 5) {
+      ds->append(array.data() + i, 5);
+    }
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    ds->Close();
+  }
+  auto pages = utils::ls(storage_path, ".page");
+  BOOST_CHECK_EQUAL(pages.size(), arr_size / meas2write);
+  mdb::Time prev_max = 0;
+  std::vector<mdb::Page::Header> headers;
+  for (auto p : pages) {
+    headers.push_back(mdb::Page::ReadHeader(p.string()));
+  }
+  std::sort(headers.begin(), headers.end(),
+            [](const mdb::Page::Header &a, const mdb::Page::Header &b) { return a.minTime < b.minTime; });
+  for (auto &hdr : headers) {
+    BOOST_CHECK(hdr.timeSorted);
+    BOOST_CHECK(prev_max <= hdr.minTime);
+    prev_max = hdr.maxTime;
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageCurValuesWithoutFlush) {
+  const std::string storage_path = mdb_test::storage_path + "storageCurNoFlush";
+  for (auto mode : {mdb::IngestMode::Locked, mdb::IngestMode::LockFreeRing, mdb::IngestMode::ThreadShards}) {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path);
+    ds->setCacheSize(1000);
+    ds->setIngestMode(mode);
+
+    std::vector<mdb::Meas> array(30);
+    for (size_t i = 0; i < array.size(); ++i) {
+      array[i].id = i % 3;
+      array[i].time = i;
+      array[i].value = i;
+    }
+    ds->append(array.data(), array.size());
+    auto single = mdb::Meas::empty();
+    single.id = 1;
+    single.time = 100;
+    single.value = 100;
+    ds->append(single);
+
+    auto values = ds->curValues(IdArray{ 0, 1, 2 });
+    std::vector<mdb::Meas> result(values.begin(), values.end());
+    BOOST_CHECK_EQUAL(result.size(), size_t(3));
+    BOOST_CHECK_EQUAL(result[0].value, mdb::Value(27));
+    BOOST_CHECK_EQUAL(result[1].value, mdb::Value(100));
+    BOOST_CHECK_EQUAL(result[2].value, mdb::Value(29));
+    // values are still in cache.
+    BOOST_CHECK_EQUAL(mdb::PageManager::get()->getCurPage()->getHeader().write_pos, uint64_t(0));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageSparePages) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 100;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageSpare";
+  utils::rm(storage_path);
+
+  std::vector<Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % 7;
+    array[i].time = i;
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setSparePages(true);
+    BOOST_CHECK(ds->sparePages());
+    ds->append(array.data(), arr_size);
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    // last values of prev page moved to page, created from spare.
+    auto ww = mdb::PageManager::get()->getCurPage()->getWriteWindow();
+    BOOST_CHECK_EQUAL(ww->size(), size_t(7));
+    ds->Close();
+    // spares removed on close.
+    BOOST_CHECK_EQUAL(utils::ls(storage_path, ".spare").size(), size_t(0));
+    BOOST_CHECK_EQUAL(utils::ls(storage_path, ".page").size(), arr_size / meas2write);
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Open(storage_path);
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageMapOptions) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 100;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageMapOptions";
+  utils::rm(storage_path);
+
+  std::vector<Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % 7;
+    array[i].time = i;
+  }
+  mdb::MapOptions options;
+  options.populate = true;
+  options.hugePages = true;
+  options.sequential = true;
+  options.dontNeed = true;
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setMapOptions(options);
+    BOOST_CHECK(ds->mapOptions().dontNeed);
+    ds->append(array.data(), arr_size);
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    ds->Close();
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Open(storage_path);
+    // options belong to storage, not to process.
+    BOOST_CHECK(!ds->mapOptions().dontNeed);
+    ds->setMapOptions(options);
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    // readers do not drop pages, second read is same.
+    all.clear();
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageColumnsAppend) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 95;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageColumns";
+  utils::rm(storage_path);
+
+  std::vector<mdb::Id> ids(arr_size);
+  std::vector<mdb::Time> times(arr_size);
+  std::vector<mdb::Value> values(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    ids[i] = i % 5;
+    times[i] = i;
+    values[i] = i * 2;
+  }
+  mdb::MeasColumns columns;
+  columns.count = arr_size;
+  columns.ids = ids.data();
+  columns.times = times.data();
+  columns.values = values.data();
+  columns.flags = mdb::Column<mdb::Flag>(mdb::Flag(3));
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setCacheSize(meas2write);
+    auto res = ds->append(columns);
+    BOOST_CHECK_EQUAL(res.writed, arr_size);
+    BOOST_CHECK_EQUAL(res.ignored, size_t(0));
+
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size);
+    for (auto m : all) {
+      BOOST_CHECK_EQUAL(m.id, m.time % 5);
+      BOOST_CHECK_EQUAL(m.value, m.time * 2);
+      BOOST_CHECK_EQUAL(m.flag, mdb::Flag(3));
+      BOOST_CHECK_EQUAL(m.source, mdb::Flag(0));
+    }
+    auto cur = ds->curValues(IdArray{ 1 });
+    BOOST_CHECK_EQUAL(cur.size(), size_t(1));
+    BOOST_CHECK_EQUAL(cur.front().time, mdb::Time(arr_size - 4));
+
+    ds->setIngestMode(mdb::IngestMode::LockFreeRing);
+    for (size_t i = 0; i < arr_size; ++i) {
+      times[i] += arr_size;
+    }
+    res = ds->append(columns);
+    BOOST_CHECK_EQUAL(res.writed, arr_size);
+    all.clear();
+    ds->readInterval(0, arr_size * 2)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), arr_size * 2);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StoragePoolDrop) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 25;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storagePoolDrop";
+  utils::rm(storage_path);
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    // only cache of pool is held by locked appender, appender of shard has no one.
+    ds->setPoolSize(1);
+    ds->setPoolPolicy(mdb::PoolPolicy::Drop);
+    ds->setIngestMode(mdb::IngestMode::ThreadShards);
+    auto m = mdb::Meas::empty();
+    for (size_t i = 0; i < arr_size; ++i) {
+      m.id = i;
+      m.time = i;
+      auto res = ds->append(m);
+      BOOST_CHECK_EQUAL(res.writed, size_t(1));
+      BOOST_CHECK_EQUAL(res.ignored, size_t(1));
+    }
+    BOOST_CHECK_EQUAL(ds->droppedCount(), uint64_t(arr_size));
+
+    ds->setIngestMode(mdb::IngestMode::Locked);
+    for (size_t i = 0; i < meas2write / 2; ++i) {
+      m.id = i;
+      m.time = i;
+      BOOST_CHECK_EQUAL(ds->append(m).ignored, size_t(0));
+    }
+    Meas::MeasList all{};
+    ds->readInterval(0, arr_size)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), meas2write / 2);
+    BOOST_CHECK_EQUAL(ds->droppedCount(), uint64_t(arr_size));
+
+    // values accepted by ring are not dropped, drain waits for cache.
+    ds->setCacheSize(meas2write);
+    ds->setIngestMode(mdb::IngestMode::LockFreeRing);
+    for (size_t i = 0; i < arr_size; ++i) {
+      m.id = i;
+      m.time = arr_size + i;
+      BOOST_CHECK_EQUAL(ds->append(m).ignored, size_t(0));
+    }
+    all.clear();
+    ds->readInterval(arr_size, arr_size * 2)->readAll(&all);
+    // interval starts by last values of ids before it.
+    auto in_ring = std::count_if(all.begin(), all.end(), [arr_size](const Meas &v) { return v.time >= arr_size; });
+    BOOST_CHECK_EQUAL(size_t(in_ring), arr_size);
+    BOOST_CHECK_EQUAL(ds->droppedCount(), uint64_t(arr_size));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageAppendAsync) {
+  const size_t meas2write = 10;
+  const size_t arr_size = 45;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageAsync";
+  utils::rm(storage_path);
+
+  std::vector<Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % 3;
+    array[i].time = i;
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    auto done = ds->appendAsync(array.data(), arr_size, true);
+    BOOST_CHECK(done.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(done.get().writed, arr_size);
+    // values are on pages, without flush of caches.
+    uint64_t on_pages = 0;
+    for (auto p : utils::ls(storage_path, ".page")) {
+      on_pages += mdb::Page::ReadHeader(p.string()).write_pos;
+    }
+    BOOST_CHECK_EQUAL(on_pages, arr_size);
+    // each filled page synced on rollover, current page synced by ticket.
+    BOOST_CHECK(ds->syncedPagesCount() >= arr_size / meas2write + 1);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+  {
+    std::atomic<size_t> completed{0};
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+    ds->setWriterLanes(2);
+    ds->setTimeOrdered(true, meas2write);
+    const size_t batches = 5;
+    const size_t batch_size = arr_size / batches;
+    for (size_t i = 0; i < batches; ++i) {
+      ds->appendAsync(array.data() + i * batch_size, batch_size,
+                      [&completed](mdb::append_result) { completed++; });
+    }
+    // last batch is not overtaken by next appends, it does not wait for close.
+    auto done = ds->appendAsync(array.data(), batch_size);
+    BOOST_CHECK(done.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(completed.load(), batches);
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageImporter) {
+  const size_t meas2write = 10;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageImport";
+  utils::rm(storage_path);
+
+  std::string csv = "id,time,value\n";
+  for (size_t i = 0; i < 45; ++i) {
+    // time in reverse order, importer sort it.
+    csv += std::to_string(i % 5) + "," + std::to_string(100 - i) + "," + std::to_string(i) + "\n";
+  }
+  csv += "broken\n1,2";
+  Meas::MeasArray values;
+  auto skipped = mdb::Importer::parseCsv(csv.data(), csv.data() + csv.size(), 3, &values);
+  BOOST_CHECK_EQUAL(skipped, size_t(3));
+  BOOST_CHECK_EQUAL(values.size(), size_t(45));
+  BOOST_CHECK_EQUAL(values[7].id, Id(2));
+  BOOST_CHECK_EQUAL(values[7].time, Time(93));
+  BOOST_CHECK_EQUAL(values[7].value, mdb::Value(7));
+  {
+    mdb::Importer importer(storage_path, storage_size);
+    importer.append(values.data(), values.size());
+    importer.close();
+    BOOST_CHECK_EQUAL(importer.pagesCount(), size_t(5));
+  }
+  for (auto p : utils::ls(storage_path, ".page")) {
+    BOOST_CHECK(mdb::Page::ReadHeader(p.string()).timeSorted);
+  }
+  {
+    mdb::Storage::Storage_ptr ds = mdb::Storage::Open(storage_path);
+    Meas::MeasList all{};
+    ds->readInterval(0, 200)->readAll(&all);
+    BOOST_CHECK_EQUAL(all.size(), size_t(45));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StoragePostings) {
+  const size_t meas2write = 100;
+  const size_t ids_count = 50;
+  const size_t arr_size = 1000;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storagePostings";
+  utils::rm(storage_path);
+
+  std::vector<mdb::Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % ids_count;
+    array[i].time = i;
+  }
+  std::vector<uint8_t> encoded;
+  mdb::Postings::encode(300, &encoded);
+  BOOST_CHECK_EQUAL(encoded.size(), size_t(2));
+  const uint8_t *pos = encoded.data();
+  BOOST_CHECK_EQUAL(mdb::Postings::decode(&pos, encoded.data() + encoded.size()), uint64_t(300));
+  pos = encoded.data();
+  BOOST_CHECK_THROW(mdb::Postings::decode(&pos, encoded.data() + 1), std::exception);
+
+  mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+  ds->enablePostings(true);
+  ds->append(array.data(), arr_size);
+  ds->Close();
+  auto postings_files = utils::ls(storage_path, ".pagep");
+  BOOST_CHECK(postings_files.size() >= arr_size / meas2write - 1);
+  auto postings = mdb::Postings::Load(postings_files.front().string());
+  BOOST_CHECK_EQUAL(postings->idsCount(), ids_count);
+  BOOST_CHECK_EQUAL(postings->positions(IdArray{ 3 }).size(), meas2write / ids_count);
+
+  ds = mdb::Storage::Open(storage_path);
+  ds->enablePostings(true);
+  Meas::MeasList readed{};
+  ds->readInterval(IdArray{ 3, 7 }, 0, 0, 0, arr_size)->readAll(&readed);
+  BOOST_CHECK_EQUAL(readed.size(), 2 * arr_size / ids_count);
+  for (auto m : readed) {
+    BOOST_CHECK((m.id == 3) || (m.id == 7));
+  }
+  readed.clear();
+  ds->readInterval(IdArray{ 3 }, 0, 0, 200, 399)->readAll(&readed);
+  size_t in_interval = 0;
+  for (auto m : readed) {
+    BOOST_CHECK_EQUAL(m.id, mdb::Id(3));
+    if (utils::inInterval(mdb::Time(200), mdb::Time(399), m.time)) {
+      in_interval++;
+    }
+  }
+  BOOST_CHECK_EQUAL(in_interval, size_t(4));
+  ds->enablePostings(false);
+  ds->Close();
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageReadSpan) {
+  const size_t meas2write = 100;
+  const size_t ids_count = 10;
+  const size_t arr_size = 1000;
+  const uint64_t storage_size = sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageReadSpan";
+  utils::rm(storage_path);
+
+  std::vector<mdb::Meas> array(arr_size);
+  for (size_t i = 0; i < arr_size; ++i) {
+    array[i].id = i % ids_count;
+    array[i].time = i;
+    array[i].value = i;
+  }
+  mdb::Storage::Storage_ptr ds = mdb::Storage::Create(storage_path, storage_size);
+  ds->append(array.data(), arr_size);
+
+  auto queries = std::vector<IdArray>{ IdArray{}, IdArray{ 2, 5 } };
+  for (auto ids : queries) {
+    Meas::MeasList expected{};
+    ds->readInterval(ids, 0, 0, 150, 750)->readAll(&expected);
+    BOOST_CHECK(!expected.empty());
+
+    Meas::MeasList readed{};
+    mdb::MeasSpan span;
+    auto reader = ds->readInterval(ids, 0, 0, 150, 750);
+    while (reader->readNextSpan(&span)) {
+      BOOST_CHECK(span.size() != 0);
+      for (size_t i = 0; i < span.size(); ++i) {
+        readed.push_back(span[i]);
+      }
+    }
+    BOOST_CHECK_EQUAL(span.size(), size_t(0));
+    BOOST_CHECK_EQUAL(readed.size(), expected.size());
+    BOOST_CHECK(std::equal(expected.begin(), expected.end(), readed.begin(),
+                           [](const Meas &a, const Meas &b) { return (a.id == b.id) && (a.time == b.time); }));
+  }
+
+  // span keeps page mapped after reader destroyed.
+  mdb::MeasSpan span;
+  {
+    auto reader = ds->readInterval(IdArray{}, 0, 0, 150, 750);
+    BOOST_CHECK(reader->readNextSpan(&span));
+  }
+  BOOST_CHECK(span.size() != 0);
+  for (size_t i = 0; i < span.size(); ++i) {
+    BOOST_CHECK_EQUAL(span[i].value, span[i].time);
+  }
+  span.clear();
+  ds->Close();
+  utils::rm(storage_path);
+}
@@ -76,3 +76,90 @@ BOOST_AUTO_TEST_CASE(StorageIOArrays) {
   }
   utils::rm(storage_path);
 }
+
+BOOST_AUTO_TEST_CASE(StorageLockFreeRing) {
+  const uint64_t storage_size =
+      sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageRing";
+
+  {
+    mdb::Storage::Storage_ptr ds =
+        mdb::Storage::Create(storage_path, storage_size);
+    ds->setIngestMode(mdb::IngestMode::LockFreeRing, 16);
+    BOOST_CHECK(ds->ingestMode() == mdb::IngestMode::LockFreeRing);
+
+    threads_count = 0;
+    std::thread t1(writer, ds);
+    std::thread t2(writer, ds);
+    std::thread t3(writer, ds);
+
+    t3.join();
+    t2.join();
+    t1.join();
+
+    Meas::MeasList meases{};
+    auto reader = ds->readInterval(0, arr_size);
+    reader->readAll(&meases);
+
+    BOOST_CHECK_EQUAL(meases.size(), arr_size * 3);
+    for (size_t i = 0; i < arr_size; ++i) {
+      int count = threads_count;
+      for (auto m : meases) {
+        if (m.id == i) {
+          count--;
+        }
+      }
+      BOOST_CHECK_EQUAL(count, 0);
+    }
+
+    ds->setPastTime(1);
+    auto wrt_res = ds->append(mdb::Meas::empty());
+    BOOST_CHECK_EQUAL(wrt_res.writed, size_t(1));
+    BOOST_CHECK_EQUAL(wrt_res.ignored, size_t(1));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
+
+BOOST_AUTO_TEST_CASE(StorageThreadShards) {
+  const uint64_t storage_size =
+      sizeof(mdb::Page::Header) + (sizeof(mdb::Meas) * meas2write);
+  const std::string storage_path = mdb_test::storage_path + "storageShards";
+
+  {
+    mdb::Storage::Storage_ptr ds =
+        mdb::Storage::Create(storage_path, storage_size);
+    ds->setCacheSize(7);
+    ds->setIngestMode(mdb::IngestMode::ThreadShards);
+
+    threads_count = 0;
+    std::thread t1(writer, ds);
+    std::thread t2(writer, ds);
+    std::thread t3(writer, ds);
+
+    t3.join();
+    t2.join();
+    t1.join();
+
+    Meas::MeasList meases{};
+    auto reader = ds->readInterval(0, arr_size);
+    reader->readAll(&meases);
+
+    BOOST_CHECK_EQUAL(meases.size(), arr_size * 3);
+    for (size_t i = 0; i < arr_size; ++i) {
+      int count = threads_count;
+      for (auto m : meases) {
+        if (m.id == i) {
+          count--;
+        }
+      }
+      BOOST_CHECK_EQUAL(count, 0);
+    }
+
+    auto cur_values = ds->curValues(IdArray{1, 2});
+    BOOST_CHECK_EQUAL(cur_values.size(), size_t(2));
+    BOOST_CHECK_EQUAL(cur_values.front().id, mdb::Id(1));
+    ds->Close();
+  }
+  utils::rm(storage_path);
+}
@@ -5,6 +5,9 @@
 #include <utils.h>
 #include <asyncworker.h>
 #include <search.h>
+#include <ringbuffer.h>
+
+#include <thread>
 
 BOOST_AUTO_TEST_CASE(UtilsEmpty) {
   BOOST_CHECK(utils::inInterval(1, 5, 1));
@@ -95,3 +98,43 @@ BOOST_AUTO_TEST_CASE(find_begin) {
     }
   }
 }
+
+BOOST_AUTO_TEST_CASE(MPSCRing) {
+  utils::MPSCRing<int> ring(3);
+  BOOST_CHECK_EQUAL(ring.capacity(), size_t(4));
+
+  int value = 0;
+  BOOST_CHECK(!ring.try_pop(&value));
+  for (int i = 0; i < 4; ++i) {
+    BOOST_CHECK(ring.try_push(i));
+  }
+  BOOST_CHECK(!ring.try_push(4));
+  for (int i = 0; i < 4; ++i) {
+    BOOST_CHECK(ring.try_pop(&value));
+    BOOST_CHECK_EQUAL(value, i);
+  }
+  BOOST_CHECK(!ring.try_pop(&value));
+
+  const int per_thread = 10000;
+  utils::MPSCRing<int> mt_ring(128);
+  auto producer = [&mt_ring]() {
+    for (int i = 1; i <= per_thread; ++i) {
+      while (!mt_ring.try_push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  };
+  std::thread t1(producer);
+  std::thread t2(producer);
+  long long sum = 0;
+  int readed = 0;
+  while (readed < per_thread * 2) {
+    if (mt_ring.try_pop(&value)) {
+      sum += value;
+      readed++;
+    }
+  }
+  t1.join();
+  t2.join();
+  BOOST_CHECK_EQUAL(sum, 2 * (long long)per_thread * (per_thread + 1) / 2);
+}
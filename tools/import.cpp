@@ -0,0 +1,112 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <importer.h>
+#include <storage.h>
+#include <logger.h>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+std::string storage_path;
+std::string input_path;
+std::string format = "csv";
+uint64_t page_size = mdb::defaultPageSize;
+size_t threads = std::thread::hardware_concurrency();
+size_t block_mb = 64;
+bool postings = false;
+
+/// read text by blocks, last not full line moved to next block.
+void importCsv(std::ifstream &input, mdb::Importer &importer, uint64_t *imported, uint64_t *skipped) {
+	std::string block;
+	std::string tail;
+	std::vector<char> buffer(block_mb * 1024 * 1024);
+	mdb::Meas::MeasArray values;
+	while (input) {
+		input.read(buffer.data(), buffer.size());
+		auto readed = size_t(input.gcount());
+		if (readed == 0) {
+			break;
+		}
+		block.assign(tail);
+		block.append(buffer.data(), readed);
+		tail.clear();
+		if (input) {
+			auto last_line = block.rfind('\n');
+			if (last_line != std::string::npos) {
+				tail = block.substr(last_line + 1);
+				block.resize(last_line + 1);
+			}
+		}
+		values.clear();
+		*skipped += mdb::Importer::parseCsv(block.data(), block.data() + block.size(), threads, &values);
+		importer.append(values.data(), values.size());
+		*imported += values.size();
+	}
+}
+
+void importBinary(std::ifstream &input, mdb::Importer &importer, uint64_t *imported) {
+	mdb::Meas::MeasArray values(block_mb * 1024 * 1024 / sizeof(mdb::Meas));
+	while (input) {
+		input.read((char *)values.data(), values.size() * sizeof(mdb::Meas));
+		auto count = size_t(input.gcount()) / sizeof(mdb::Meas);
+		importer.append(values.data(), count);
+		*imported += count;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	po::options_description desc("Bulk import of values to closed storage.\n Allowed options");
+	desc.add_options()("help", "produce help message")
+		("storage", po::value<std::string>(&storage_path), "storage path")
+		("input", po::value<std::string>(&input_path), "input file")
+		("format", po::value<std::string>(&format)->default_value(format), "csv (id,time,value[,source[,flag]]) | binary (array of Meas)")
+		("page-size", po::value<uint64_t>(&page_size)->default_value(page_size), "page size in bytes")
+		("threads", po::value<size_t>(&threads)->default_value(threads), "csv parser threads")
+		("block", po::value<size_t>(&block_mb)->default_value(block_mb), "size of readed block in Mb")
+		("postings", po::value<bool>(&postings)->default_value(postings), "build id postings of pages");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+	} catch (std::exception &ex) {
+		logger("Error: " << ex.what());
+		exit(1);
+	}
+	po::notify(vm);
+
+	if (vm.count("help") || storage_path.empty() || input_path.empty()) {
+		std::cout << desc << std::endl;
+		return 1;
+	}
+
+	std::ifstream input(input_path, std::ifstream::binary | std::ifstream::in);
+	if (!input.is_open()) {
+		logger("Error: can`t open " << input_path);
+		return 1;
+	}
+
+	uint64_t imported = 0;
+	uint64_t skipped = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	try {
+		mdb::Importer importer(storage_path, page_size);
+		importer.enablePostings(postings);
+		if (format == "binary") {
+			importBinary(input, importer, &imported);
+		} else {
+			importCsv(input, importer, &imported, &skipped);
+		}
+		importer.close();
+		auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		logger("imported: " << imported << " skipped lines: " << skipped << " pages: " << importer.pagesCount()
+		       << " time: " << secs << " sec.");
+	} catch (std::exception &ex) {
+		logger("Error: " << ex.what());
+		return 1;
+	}
+	return 0;
+}